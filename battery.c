@@ -0,0 +1,145 @@
+// Battery Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Battery:
+//   Motor supply (4 AA cells) through a 20k/10k divider to AIN1 (PE2)
+//   Read by ADC0 sample sequencer 2, started by a periodic timer of the timer service
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "timer.h"
+#include "battery.h"
+
+// PortE masks
+#define BATTERY_MASK 4
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+volatile uint32_t battery;          // filtered, mV scaled by 2^BATTERY_FILTER_SHIFT
+volatile bool batteryValid = false;
+volatile bool batteryLow = false;
+volatile uint16_t batteryGain = BATTERY_GAIN_ONE;
+bool batteryCompensation = true;
+_batteryCallback batteryCallback = 0;   // called from the interrupt when the warning changes
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Start a conversion; the result is filtered in the interrupt
+void startBatterySample()
+{
+    ADC0_PSSI_R = ADC_PSSI_SS2;
+}
+
+// Initialize ADC0 sample sequencer 2 to read AIN1 every BATTERY_PERIOD_MS
+// Call after initTemperature() and initTimer(), port E must be clocked
+void initBattery()
+{
+    GPIO_PORTE_DIR_R &= ~BATTERY_MASK;
+    GPIO_PORTE_DEN_R &= ~BATTERY_MASK;                  // analog only
+    GPIO_PORTE_AFSEL_R |= BATTERY_MASK;
+    GPIO_PORTE_AMSEL_R |= BATTERY_MASK;
+
+    SYSCTL_RCGCADC_R |= SYSCTL_RCGCADC_R0;
+    _delay_cycles(16);
+
+    ADC0_ACTSS_R &= ~ADC_ACTSS_ASEN2;                   // disable sample sequencer 2 (SS2) for programming
+    ADC0_EMUX_R &= ~ADC_EMUX_EM2_M;                     // select SS2 bit in ADCPSSI as trigger
+    ADC0_SSMUX2_R = 1;                                  // AIN1
+    ADC0_SSCTL2_R = ADC_SSCTL2_IE0 | ADC_SSCTL2_END0;   // interrupt at end of a single sample
+    ADC0_ISC_R = ADC_ISC_IN2;
+    ADC0_IM_R |= ADC_IM_MASK2;
+    NVIC_EN0_R |= 1 << (INT_ADC0SS2-16);
+    ADC0_ACTSS_R |= ADC_ACTSS_ASEN2;                    // enable SS2 for operation
+
+    startPeriodicTimer(startBatterySample, BATTERY_PERIOD_MS);
+}
+
+bool isBatteryValid()
+{
+    return batteryValid;
+}
+
+// Returns the filtered battery voltage in mV
+uint16_t getBatteryVoltage()
+{
+    return battery >> BATTERY_FILTER_SHIFT;
+}
+
+bool isBatteryLow()
+{
+    return batteryLow;
+}
+
+// Returns the factor that keeps the motor voltage at BATTERY_NOMINAL_MV, in Q12
+// A full battery slows the motors down as much as a weak one speeds them up, up to
+// BATTERY_MAX_GAIN; without a reading or with compensation off the factor is 1
+uint16_t getBatteryGain()
+{
+    if (!batteryCompensation)
+        return BATTERY_GAIN_ONE;
+    return batteryGain;
+}
+
+void setBatteryCompensation(bool on)
+{
+    batteryCompensation = on;
+}
+
+bool isBatteryCompensation()
+{
+    return batteryCompensation;
+}
+
+// Call a function from the interrupt when the low-battery warning starts or ends
+void setBatteryCallback(_batteryCallback callback)
+{
+    batteryCallback = callback;
+}
+
+// VBAT = BATTERY_DIVIDER * VREFP * raw / 4096, with VREFP = 3.3 V
+// The warning has hysteresis so the sag of a move does not toggle it
+void adc0Ss2Isr()
+{
+    uint32_t sample, mv, gain;
+    bool low;
+
+    ADC0_ISC_R = ADC_ISC_IN2;
+    sample = ((BATTERY_DIVIDER * 3300 * (ADC0_SSFIFO2_R & 0xFFF)) / 4096) << BATTERY_FILTER_SHIFT;
+    if (!batteryValid)
+    {
+        battery = sample;
+        batteryValid = true;
+    }
+    else
+        battery += ((int32_t)sample - (int32_t)battery) >> BATTERY_FILTER_SHIFT;
+
+    mv = battery >> BATTERY_FILTER_SHIFT;
+    gain = mv ? (BATTERY_NOMINAL_MV << BATTERY_GAIN_SHIFT) / mv : BATTERY_MAX_GAIN;
+    batteryGain = gain > BATTERY_MAX_GAIN ? BATTERY_MAX_GAIN : gain;
+
+    low = batteryLow ? mv < BATTERY_LOW_MV + BATTERY_HYST_MV : mv < BATTERY_LOW_MV;
+    if (low != batteryLow)
+    {
+        batteryLow = low;
+        if (batteryCallback)
+            batteryCallback(low);
+    }
+}
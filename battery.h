@@ -0,0 +1,55 @@
+// Battery Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Battery:
+//   Motor supply (4 AA cells) through a 20k/10k divider to AIN1 (PE2)
+//   Read by ADC0 sample sequencer 2, started by a periodic timer of the timer service
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef BATTERY_H_
+#define BATTERY_H_
+
+#define BATTERY_PERIOD_MS    100
+#define BATTERY_FILTER_SHIFT 3      // IIR weight of a new sample is 1/8
+
+// Battery voltage = pin voltage * (20k + 10k) / 10k
+#define BATTERY_DIVIDER 3
+
+#define BATTERY_NOMINAL_MV 6000     // the motor model was trimmed at this voltage
+#define BATTERY_LOW_MV     4400     // warn below this
+#define BATTERY_HYST_MV    200      // the warning clears this far above the low voltage
+
+// Motor duties are scaled by nominal / battery voltage in Q12
+#define BATTERY_GAIN_SHIFT 12
+#define BATTERY_GAIN_ONE   (1 << BATTERY_GAIN_SHIFT)
+#define BATTERY_MAX_GAIN   (BATTERY_GAIN_ONE * 3 / 2)
+
+typedef void (*_batteryCallback)(bool low);
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initBattery(void);
+bool isBatteryValid(void);
+uint16_t getBatteryVoltage(void);
+bool isBatteryLow(void);
+uint16_t getBatteryGain(void);
+void setBatteryCompensation(bool on);
+bool isBatteryCompensation(void);
+void setBatteryCallback(_batteryCallback callback);
+void adc0Ss2Isr(void);
+
+#endif
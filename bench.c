@@ -0,0 +1,136 @@
+// Benchmark Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// DWT:
+//   The cycle counter timestamps both ends of every measurement
+// Timer 5A interrupt:
+//   Triggered in software for the interrupt latency; the timer itself is not used
+// Timer 1:
+//   The free-running system clock timer of the ultrasonic library is the reference
+//   the delays are checked against
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "clock.h"
+#include "kernel.h"
+#include "wait.h"
+#include "bench.h"
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+SEMAPHORE benchWake;
+volatile uint32_t benchStamp;       // cycle count taken by the thread or the ISR
+volatile bool benchDone;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Stamps the time it resumes after each post
+void benchThread()
+{
+    while (true)
+    {
+        wait(&benchWake);
+        benchStamp = DWT_CYCCNT_R;
+    }
+}
+
+// Create the benchmark thread and enable the software-triggered interrupt
+// Call before the kernel starts
+void initBench()
+{
+    initSemaphore(&benchWake, 0);
+    createThread(benchThread, "bench", BENCH_PRIORITY, BENCH_STACK_BYTES);
+    NVIC_EN2_R |= 1 << (INT_TIMER5A-16-64);
+}
+
+void addSample(BENCH_RESULT* result, uint32_t cycles, uint32_t* sum)
+{
+    if (cycles < result->min)
+        result->min = cycles;
+    if (cycles > result->max)
+        result->max = cycles;
+    *sum += cycles;
+}
+
+// Time from a post to the first instruction of the woken thread after its wait:
+// the post, PendSV saving this thread, the scheduler and restoring the other one
+// Must be called from a thread of lower priority than BENCH_PRIORITY
+void benchContextSwitch(BENCH_RESULT* result)
+{
+    uint32_t start, sum = 0;
+    uint16_t i;
+
+    result->min = 0xFFFFFFFF;
+    result->max = 0;
+    for (i = 0; i < BENCH_RUNS; i++)
+    {
+        start = DWT_CYCCNT_R;
+        post(&benchWake);
+        addSample(result, benchStamp - start, &sum);
+    }
+    result->mean = sum / BENCH_RUNS;
+}
+
+// Time from the write that pends the interrupt to the first statement of its ISR
+void benchInterruptLatency(BENCH_RESULT* result)
+{
+    uint32_t start, sum = 0;
+    uint16_t i;
+
+    result->min = 0xFFFFFFFF;
+    result->max = 0;
+    for (i = 0; i < BENCH_RUNS; i++)
+    {
+        benchDone = false;
+        start = DWT_CYCCNT_R;
+        NVIC_SW_TRIG_R = INT_TIMER5A-16;
+        while (!benchDone);
+        addSample(result, benchStamp - start, &sum);
+    }
+    result->mean = sum / BENCH_RUNS;
+}
+
+// Returns the length of a delay in ns as measured on TIMER1, a peripheral timer
+// that does not depend on the core pipeline or the flash wait states
+// Whole microseconds are timed through waitMicrosecond, anything else through
+// waitNanosecond; interrupts are masked so only the delay is measured
+uint32_t benchDelay(uint32_t ns)
+{
+    uint32_t mask, start, end;
+
+    if (ns > BENCH_MAX_DELAY_US * 1000)
+        ns = BENCH_MAX_DELAY_US * 1000;
+    mask = disableInterrupts();
+    start = TIMER1_TAV_R;
+    if (ns % 1000 == 0)
+        waitMicrosecond(ns / 1000);
+    else
+        waitNanosecond(ns);
+    end = TIMER1_TAV_R;
+    restoreInterrupts(mask);
+    return (end - start) * 1000 / (getSystemClock() / 1000000);
+}
+
+void benchIsr()
+{
+    benchStamp = DWT_CYCCNT_R;
+    benchDone = true;
+}
@@ -0,0 +1,51 @@
+// Benchmark Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// DWT:
+//   The cycle counter timestamps both ends of every measurement
+// Timer 5A interrupt:
+//   Triggered in software for the interrupt latency; the timer itself is not used
+// Timer 1:
+//   The free-running system clock timer of the ultrasonic library is the reference
+//   the delays are checked against
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#define BENCH_PRIORITY    1         // must be above the thread that runs the benchmark
+#define BENCH_STACK_BYTES 256
+#define BENCH_RUNS        100
+#define BENCH_MAX_DELAY_US 500      // interrupts are masked while a delay is timed
+
+// Spread of a measurement, in cycles
+typedef struct _BENCH_RESULT
+{
+    uint32_t min;
+    uint32_t max;
+    uint32_t mean;
+} BENCH_RESULT;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initBench(void);
+void benchContextSwitch(BENCH_RESULT* result);
+void benchInterruptLatency(BENCH_RESULT* result);
+uint32_t benchDelay(uint32_t ns);
+void benchIsr(void);
+
+#endif
@@ -20,17 +20,75 @@
 #include "clock.h"
 #include "tm4c123gh6pm.h"
 
+// Debug and trace registers
+#define DEMCR_R            (*((volatile uint32_t *)0xE000EDFC))
+#define DEMCR_TRCENA       0x01000000
+#define DWT_CTRL_R         (*((volatile uint32_t *)0xE0001000))
+#define DWT_CTRL_CYCCNTENA 0x00000001
+
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
 
+uint32_t systemClockHz = F_CPU;
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-// Initialize system clock to 40 MHz using PLL and 16 MHz crystal oscillator
-void initSystemClockTo40Mhz(void)
+// Initialize system clock to 80 MHz using PLL and 16 MHz crystal oscillator
+// RCC2 is used since the 400 MHz PLL output divided by 5 is only reachable with SYSDIV2
+void initSystemClockTo80Mhz(void)
+{
+    // Bypass the PLL while it is reconfigured, enable the 16 MHz crystal
+    SYSCTL_RCC2_R |= SYSCTL_RCC2_USERCC2 | SYSCTL_RCC2_BYPASS2;
+    SYSCTL_RCC_R = SYSCTL_RCC_XTAL_16MHZ | SYSCTL_RCC_OSCSRC_MAIN | SYSCTL_RCC_USESYSDIV;
+
+    // Main oscillator, PLL powered, 400 MHz PLL output divided by (2*2+0)+1 = 5, creating system clock of 80 MHz
+    SYSCTL_RCC2_R = SYSCTL_RCC2_USERCC2 | SYSCTL_RCC2_DIV400 | SYSCTL_RCC2_BYPASS2 | SYSCTL_RCC2_OSCSRC2_MO
+                  | (2 << SYSCTL_RCC2_SYSDIV2_S);
+
+    // Wait for the PLL to lock, then switch the system clock to it
+    while (!(SYSCTL_PLLSTAT_R & SYSCTL_PLLSTAT_LOCK));
+    SYSCTL_RCC2_R &= ~SYSCTL_RCC2_BYPASS2;
+    systemClockHz = F_CPU;
+}
+
+// Power up the PLL and wait for it to lock, the core keeps running from the crystal
+void startPll(void)
+{
+    SYSCTL_RCC2_R &= ~SYSCTL_RCC2_PWRDN2;
+    while (!(SYSCTL_PLLSTAT_R & SYSCTL_PLLSTAT_LOCK));
+}
+
+// Run the core from the locked PLL at F_CPU, startPll() must have returned
+// The system divider cleared by useCrystalClock() is restored before the PLL is selected
+void usePllClock(void)
+{
+    SYSCTL_RCC_R |= SYSCTL_RCC_USESYSDIV;
+    SYSCTL_RCC2_R &= ~SYSCTL_RCC2_BYPASS2;
+    systemClockHz = F_CPU;
+}
+
+// Run the core from the undivided 16 MHz crystal at F_IDLE and power down the PLL
+void useCrystalClock(void)
+{
+    SYSCTL_RCC2_R |= SYSCTL_RCC2_BYPASS2;
+    SYSCTL_RCC_R &= ~SYSCTL_RCC_USESYSDIV;
+    SYSCTL_RCC2_R |= SYSCTL_RCC2_PWRDN2;
+    systemClockHz = F_IDLE;
+}
+
+// Returns the current system clock in Hz
+uint32_t getSystemClock(void)
+{
+    return systemClockHz;
+}
+
+// Start the free-running cycle counter of the DWT, read with DWT_CYCCNT_R
+void initCycleCounter(void)
 {
-    // Configure HW to work with 16 MHz XTAL, PLL enabled, sysdivider of 5, creating system clock of 40 MHz
-    SYSCTL_RCC_R = SYSCTL_RCC_XTAL_16MHZ | SYSCTL_RCC_OSCSRC_MAIN | SYSCTL_RCC_USESYSDIV | (4 << SYSCTL_RCC_SYSDIV_S);
+    DEMCR_R |= DEMCR_TRCENA;
+    DWT_CYCCNT_R = 0;
+    DWT_CTRL_R |= DWT_CTRL_CYCCNTENA;
 }
@@ -19,10 +19,25 @@
 #ifndef CLOCK_H_
 #define CLOCK_H_
 
+// System clock produced by initSystemClockTo80Mhz() and usePllClock()
+// Every baud rate, timer load and delay is derived from getSystemClock()
+#define F_CPU 80000000
+
+// System clock produced by useCrystalClock(), the PLL is powered down
+#define F_IDLE 16000000
+
+// Cycle counter of the data watchpoint and trace unit (not in tm4c123gh6pm.h)
+#define DWT_CYCCNT_R (*((volatile uint32_t *)0xE0001004))
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-void initSystemClockTo40Mhz(void);
+void initSystemClockTo80Mhz(void);
+void startPll(void);
+void usePllClock(void);
+void useCrystalClock(void);
+uint32_t getSystemClock(void);
+void initCycleCounter(void);
 
 #endif
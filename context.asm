@@ -0,0 +1,74 @@
+; Context Switch Library
+; Nicholas Untrecht
+
+;-----------------------------------------------------------------------------
+; Hardware Target
+;-----------------------------------------------------------------------------
+
+; Target Platform: EK-TM4C123GXL
+; Target uC:       TM4C123GH6PM
+; System Clock:    80 MHz
+
+;-----------------------------------------------------------------------------
+; Device includes, defines, and assembler directives
+;-----------------------------------------------------------------------------
+
+    .def pendSvIsr
+    .def setPsp
+    .def usePsp
+    .def disableInterrupts
+    .def restoreInterrupts
+    .ref switchContext
+
+;-----------------------------------------------------------------------------
+; Subroutines
+;-----------------------------------------------------------------------------
+
+    .thumb
+    .text
+
+; Switch threads
+; The hardware has stacked R0-R3, R12, LR, PC and xPSR on the process stack, plus
+; room for S0-S15 and FPSCR if the thread used the FPU (EXC_RETURN bit 4 clear);
+; those are only written if the FPU is used again before the frame is popped.
+; The software frame is R4-R11 and EXC_RETURN, with S16-S31 below them for an FPU
+; thread. switchContext takes the old stack pointer and returns the new one.
+pendSvIsr:
+    MRS     R0, PSP
+    TST     LR, #0x10
+    IT      EQ
+    VSTMDBEQ R0!, {S16-S31}
+    STMDB   R0!, {R4-R11, LR}
+    BL      switchContext
+    LDMIA   R0!, {R4-R11, LR}
+    TST     LR, #0x10
+    IT      EQ
+    VLDMIAEQ R0!, {S16-S31}
+    MSR     PSP, R0
+    BX      LR
+
+; Set the process stack pointer
+setPsp:
+    MSR     PSP, R0
+    BX      LR
+
+; Run thread mode from the process stack
+usePsp:
+    MRS     R0, CONTROL
+    ORR     R0, R0, #2
+    MSR     CONTROL, R0
+    ISB
+    BX      LR
+
+; Mask interrupts and return the previous mask
+disableInterrupts:
+    MRS     R0, PRIMASK
+    CPSID   I
+    BX      LR
+
+; Restore the mask returned by disableInterrupts
+restoreInterrupts:
+    MSR     PRIMASK, R0
+    BX      LR
+
+    .end
@@ -0,0 +1,141 @@
+// Driver Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Motor driver:
+//   SLEEP (PB6), high to enable the H-bridge
+// Idle timeout:
+//   One-shot timer of the timer service
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "kernel.h"
+#include "motion.h"
+#include "supervisor.h"
+#include "timer.h"
+#include "driver.h"
+
+// Bitbanding Aliases
+#define SLEEP_PIN  (*((volatile uint32_t *)(0x42000000 + (0x400053FC-0x40000000)*32 + 6*4))) // PB6
+
+// PortB masks
+#define SLEEP_MASK 64
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+bool driverAwake = false;
+uint32_t driverWakeUs;              // time SLEEP went high
+uint32_t driverIdleMs = DRIVER_IDLE_MS;
+uint32_t driverWakes = 0;
+uint32_t driverAsleepMs = 0;        // time asleep before the last wake
+uint32_t driverSleepStart;          // time the driver last went to sleep, ms
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Drive SLEEP and start with the H-bridge asleep
+// Call after initTimer() and initSupervisor(), port B must be clocked
+void initDriver()
+{
+    GPIO_PORTB_DIR_R |= SLEEP_MASK;
+    GPIO_PORTB_DR2R_R |= SLEEP_MASK;
+    GPIO_PORTB_DEN_R |= SLEEP_MASK;
+    SLEEP_PIN = 0;
+    driverAwake = false;
+    driverSleepStart = getTimeMs();
+}
+
+// The idle timeout ended; a move that is still running keeps the driver awake
+void idleDriver()
+{
+    if (isMoving())
+        startOneshotTimer(idleDriver, driverIdleMs);
+    else
+        sleepDriver();
+}
+
+// Wake the H-bridge for a move and restart the idle timeout
+// Returns true once the outputs have settled; until then a move would lose its first ticks
+// Masked so the watchdog cannot put the driver to sleep halfway through the wake
+bool wakeDriver()
+{
+    uint32_t mask;
+
+    startOneshotTimer(idleDriver, driverIdleMs);
+    mask = disableInterrupts();
+    if (!driverAwake)
+    {
+        driverWakeUs = getTimeUs();
+        driverAsleepMs += getTimeMs() - driverSleepStart;
+        driverWakes++;
+        driverAwake = true;
+        SLEEP_PIN = 1;
+    }
+    restoreInterrupts(mask);
+    return isDriverReady();
+}
+
+bool isDriverReady()
+{
+    return driverAwake && getTimeUs() - driverWakeUs >= DRIVER_WAKE_US;
+}
+
+bool isDriverAwake()
+{
+    return driverAwake;
+}
+
+// Put the H-bridge to sleep at once; safe to call from an interrupt
+void sleepDriver()
+{
+    SLEEP_PIN = 0;
+    if (driverAwake)
+    {
+        driverAwake = false;
+        driverSleepStart = getTimeMs();
+    }
+}
+
+// Set the time without a move before the driver sleeps, applied from the next wake
+bool setDriverIdleTime(uint32_t ms)
+{
+    if (ms < DRIVER_MIN_IDLE_MS)
+        return false;
+    driverIdleMs = ms;
+    return true;
+}
+
+uint32_t getDriverIdleTime()
+{
+    return driverIdleMs;
+}
+
+// Returns the number of wakes since power up
+uint32_t getDriverWakes()
+{
+    return driverWakes;
+}
+
+// Returns the time the driver spent asleep since power up, including the current sleep
+uint32_t getDriverAsleepMs()
+{
+    if (driverAwake)
+        return driverAsleepMs;
+    return driverAsleepMs + getTimeMs() - driverSleepStart;
+}
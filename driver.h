@@ -0,0 +1,46 @@
+// Driver Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Motor driver:
+//   SLEEP (PB6), high to enable the H-bridge
+// Idle timeout:
+//   One-shot timer of the timer service
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef DRIVER_H_
+#define DRIVER_H_
+
+// Time from SLEEP high until the outputs follow their inputs (DRV8833 tWAKE)
+#define DRIVER_WAKE_US 1000
+
+// The driver sleeps once no move has run for this long
+#define DRIVER_IDLE_MS      2000
+#define DRIVER_MIN_IDLE_MS  10
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initDriver(void);
+bool wakeDriver(void);
+bool isDriverReady(void);
+bool isDriverAwake(void);
+void sleepDriver(void);
+bool setDriverIdleTime(uint32_t ms);
+uint32_t getDriverIdleTime(void);
+uint32_t getDriverWakes(void);
+uint32_t getDriverAsleepMs(void);
+
+#endif
@@ -0,0 +1,193 @@
+// Events Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Push buttons:
+//   SW1 (PF4) and SW2 (PF0), active low with internal pull-ups
+//   Both edges interrupt on GPIO port F; PF0 is unlocked from its NMI function
+// Debounce:
+//   One-shot timers of the timer service
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "kernel.h"
+#include "timer.h"
+#include "events.h"
+
+typedef struct _EVENT_PIN
+{
+    uint8_t mask;           // port F pin
+    bool pressed;           // debounced state
+    uint32_t bounces;       // debounce times that saw extra edges
+    QUEUE queue;            // EVENT_xxx not yet taken by a task
+} EVENT_PIN;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+EVENT_PIN eventPins[EVENT_PINS] =
+{
+    {16},                   // SW1: PF4
+    {1},                    // SW2: PF0
+};
+_eventCallback eventCallback = 0;   // called from the interrupt of every event
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Configure both buttons for edge interrupts
+// Call after initTimer() and before the kernel starts, port F must be clocked;
+// an edge at boot arms a debounce timer that initTimer() would otherwise wipe
+void initEvents()
+{
+    uint8_t masks = 0;
+    uint8_t i;
+
+    GPIO_PORTF_LOCK_R = GPIO_LOCK_KEY;
+    GPIO_PORTF_CR_R |= 1;                               // allow PF0 to be reconfigured
+    GPIO_PORTF_LOCK_R = 0;
+    for (i = 0; i < EVENT_PINS; i++)
+    {
+        initQueue(&eventPins[i].queue);
+        eventPins[i].bounces = 0;
+        masks |= eventPins[i].mask;
+    }
+    GPIO_PORTF_DIR_R &= ~masks;
+    GPIO_PORTF_PUR_R |= masks;
+    GPIO_PORTF_DEN_R |= masks;
+    _delay_cycles(16);                                  // let the pull-ups charge the inputs
+    for (i = 0; i < EVENT_PINS; i++)
+        eventPins[i].pressed = !(GPIO_PORTF_DATA_R & eventPins[i].mask);
+    GPIO_PORTF_IS_R &= ~masks;                          // edge sensitive
+    GPIO_PORTF_IBE_R |= masks;                          // on both edges
+    GPIO_PORTF_ICR_R = masks;
+    GPIO_PORTF_IM_R |= masks;
+    NVIC_EN0_R |= 1 << (INT_GPIOF-16);
+}
+
+// Call a function from the interrupt of every press and release
+void setEventCallback(_eventCallback callback)
+{
+    eventCallback = callback;
+}
+
+// Returns the debounced state of a button
+bool isPressed(uint8_t pin)
+{
+    return eventPins[pin].pressed;
+}
+
+// Take the oldest event of a pin, blocking until there is one
+uint8_t waitEvent(uint8_t pin)
+{
+    return queueReceive(&eventPins[pin].queue);
+}
+
+// Take the oldest event of a pin if there is one
+bool tryEvent(uint8_t pin, uint8_t* event)
+{
+    uint32_t message;
+    if (!queueTryReceive(&eventPins[pin].queue, &message))
+        return false;
+    *event = message;
+    return true;
+}
+
+// Forget the events of a pin nobody took, so a wait only sees new ones
+void flushEvents(uint8_t pin)
+{
+    uint8_t event;
+    while (tryEvent(pin, &event));
+}
+
+// Returns the number of debounce times that saw extra edges since power up
+uint32_t getEventBounces(uint8_t pin)
+{
+    return eventPins[pin].bounces;
+}
+
+// Report a change of the debounced state to the pin's queue and the callback
+// A full queue drops the newest event
+void reportEvent(uint8_t pin, bool pressed)
+{
+    uint8_t event = pressed ? EVENT_PRESS : EVENT_RELEASE;
+    eventPins[pin].pressed = pressed;
+    queueSend(&eventPins[pin].queue, event);
+    if (eventCallback)
+        eventCallback(pin, event);
+}
+
+void endDebounceSw1(void);
+void endDebounceSw2(void);
+
+// The timer service calls back without arguments, so every pin has its own callback
+_callback debounceCallbacks[EVENT_PINS] = {endDebounceSw1, endDebounceSw2};
+
+// End of the debounce time of a pin
+// A level that changed during the time is reported now and debounced again;
+// otherwise the edge interrupt is turned back on
+void endDebounce(uint8_t pin)
+{
+    EVENT_PIN *p = &eventPins[pin];
+    bool pressed = !(GPIO_PORTF_DATA_R & p->mask);
+    if (GPIO_PORTF_RIS_R & p->mask)
+        p->bounces++;                                   // edges were latched while masked
+    GPIO_PORTF_ICR_R = p->mask;
+    if (pressed != p->pressed)
+    {
+        reportEvent(pin, pressed);
+        startOneshotTimer(debounceCallbacks[pin], EVENT_DEBOUNCE_MS);
+    }
+    else
+        GPIO_PORTF_IM_R |= p->mask;
+}
+
+void endDebounceSw1()
+{
+    endDebounce(EVENT_SW1);
+}
+
+void endDebounceSw2()
+{
+    endDebounce(EVENT_SW2);
+}
+
+// An edge on a button: the new state is reported at once and the pin's interrupt
+// stays off until the debounce time has passed
+void eventPortFIsr()
+{
+    uint32_t status = GPIO_PORTF_MIS_R;
+    EVENT_PIN *p;
+    bool pressed;
+    uint8_t i;
+
+    for (i = 0; i < EVENT_PINS; i++)
+    {
+        p = &eventPins[i];
+        if (!(status & p->mask))
+            continue;
+        GPIO_PORTF_ICR_R = p->mask;
+        GPIO_PORTF_IM_R &= ~p->mask;
+        pressed = !(GPIO_PORTF_DATA_R & p->mask);
+        if (pressed != p->pressed)
+            reportEvent(i, pressed);
+        else
+            p->bounces++;
+        startOneshotTimer(debounceCallbacks[i], EVENT_DEBOUNCE_MS);
+    }
+}
@@ -0,0 +1,54 @@
+// Events Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Push buttons:
+//   SW1 (PF4) and SW2 (PF0), active low with internal pull-ups
+//   Both edges interrupt on GPIO port F; PF0 is unlocked from its NMI function
+// Debounce:
+//   One-shot timers of the timer service
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef EVENTS_H_
+#define EVENTS_H_
+
+// Event inputs
+#define EVENT_SW1  0
+#define EVENT_SW2  1
+#define EVENT_PINS 2
+
+// Events
+#define EVENT_RELEASE 0
+#define EVENT_PRESS   1
+
+// An edge is reported at once; further edges are ignored for this long and the
+// level is checked again at its end
+#define EVENT_DEBOUNCE_MS 20
+
+typedef void (*_eventCallback)(uint8_t pin, uint8_t event);
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initEvents(void);
+void setEventCallback(_eventCallback callback);
+bool isPressed(uint8_t pin);
+uint8_t waitEvent(uint8_t pin);
+bool tryEvent(uint8_t pin, uint8_t* event);
+void flushEvents(uint8_t pin);
+uint32_t getEventBounces(uint8_t pin);
+void eventPortFIsr(void);
+
+#endif
@@ -0,0 +1,437 @@
+// Kernel Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// PendSV:
+//   Switches threads at the lowest exception priority (context.asm)
+// SysTick:
+//   The 1 ms tick of the timer service wakes sleeping threads and ends time slices
+// DWT:
+//   The cycle counter times every thread
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "clock.h"
+#include "timer.h"
+#include "kernel.h"
+
+#define STACK_PAINT      0xA5A5A5A5
+#define START_STACK_WORDS 64
+#define EXC_RETURN_PSP   0xFFFFFFFD     // thread mode, process stack, no FPU frame
+#define XPSR_THUMB       0x01000000
+#define PENDSV_LOWEST    (7 << 21)
+#define CYCLES_PER_US    (getSystemClock() / 1000000)
+
+typedef struct _THREAD
+{
+    uint32_t sp;                // saved stack pointer, points at R4 of the software frame
+    uint32_t* stack;            // lowest word of the stack
+    uint32_t stackWords;
+    char* name;
+    uint8_t priority;           // 0 is the highest
+    uint8_t state;              // THREAD_xxx
+    uint32_t ticks;             // delayed: ms left, blocked: ms to the timeout or 0 for none
+    SEMAPHORE* semaphore;       // blocked: semaphore waited on
+    bool timedOut;              // the last timed wait ended without a count
+    uint32_t runs;              // bursts that ended in a sleep or a wait
+    uint32_t burst;             // cycles run since the thread last blocked
+    uint32_t wcet;              // longest burst, cycles
+    uint64_t cycles;            // cycles run since the statistics were reset
+} THREAD;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+THREAD threads[MAX_THREADS];
+uint8_t threadCount = 0;
+uint8_t current = NO_THREAD;
+uint8_t sliceTicks = 0;
+uint32_t runStart;                          // cycle count the current thread was switched in
+uint32_t switchCount = 0;
+uint64_t totalCycles = 0;
+
+uint64_t kernelHeap[KERNEL_HEAP_BYTES / 8]; // 8-byte aligned stacks
+uint32_t heapUsed = 0;                      // bytes
+uint64_t startStack[START_STACK_WORDS / 2]; // takes the frame of main when the kernel starts
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Called if a thread function returns
+void threadExit()
+{
+    uint32_t mask = disableInterrupts();
+    threads[current].state = THREAD_STOPPED;
+    NVIC_INT_CTRL_R = NVIC_INT_CTRL_PEND_SV;
+    restoreInterrupts(mask);
+    while (true);
+}
+
+// Add a thread with its own stack from the kernel heap
+// The stack is painted so its high-water mark can be read, and holds the frames
+// PendSV restores: the hardware frame that starts the function and the software
+// frame of R4-R11 and EXC_RETURN
+bool createThread(_fn fn, char* name, uint8_t priority, uint32_t stackBytes)
+{
+    THREAD *t;
+    uint32_t *sp;
+    uint32_t i;
+
+    stackBytes = (stackBytes + 7) & ~7;
+    if (threadCount == MAX_THREADS || heapUsed + stackBytes > KERNEL_HEAP_BYTES)
+        return false;
+    t = &threads[threadCount];
+    t->stack = (uint32_t *)kernelHeap + heapUsed / 4;
+    t->stackWords = stackBytes / 4;
+    heapUsed += stackBytes;
+    for (i = 0; i < t->stackWords; i++)
+        t->stack[i] = STACK_PAINT;
+
+    sp = t->stack + t->stackWords - 17;
+    for (i = 0; i < 8; i++)
+        sp[i] = 0;                          // R4-R11
+    sp[8] = EXC_RETURN_PSP;
+    for (i = 9; i < 14; i++)
+        sp[i] = 0;                          // R0-R3, R12
+    sp[14] = (uint32_t)threadExit;          // LR
+    sp[15] = (uint32_t)fn & ~1;             // PC
+    sp[16] = XPSR_THUMB;
+
+    t->sp = (uint32_t)sp;
+    t->name = name;
+    t->priority = priority;
+    t->state = THREAD_READY;
+    t->semaphore = 0;
+    t->timedOut = false;
+    t->runs = 0;
+    t->burst = 0;
+    t->wcet = 0;
+    t->cycles = 0;
+    threadCount++;
+    return true;
+}
+
+// Returns the ready thread of the highest priority
+// Threads of equal priority take turns: the search starts after the current one
+uint8_t nextThread()
+{
+    uint8_t i, k, best = NO_THREAD;
+    uint8_t start = current == NO_THREAD ? threadCount - 1 : current;
+    for (k = 1; k <= threadCount; k++)
+    {
+        i = (start + k) % threadCount;
+        if (threads[i].state == THREAD_READY && (best == NO_THREAD || threads[i].priority < threads[best].priority))
+            best = i;
+    }
+    return best;
+}
+
+// Called from PendSV with the stack pointer of the thread being switched out
+// Returns the stack pointer of the thread to run
+// A thread that is no longer ready has finished a burst, whose length in cycles is
+// its run time; time spent preempted is not counted
+uint32_t switchContext(uint32_t sp)
+{
+    THREAD *t;
+    uint32_t now, run;
+    uint32_t mask = disableInterrupts();
+
+    now = DWT_CYCCNT_R;
+    if (current != NO_THREAD)
+    {
+        t = &threads[current];
+        t->sp = sp;
+        run = now - runStart;
+        t->burst += run;
+        t->cycles += run;
+        totalCycles += run;
+        if (t->state != THREAD_READY)
+        {
+            t->runs++;
+            if (t->burst > t->wcet)
+                t->wcet = t->burst;
+            t->burst = 0;
+        }
+    }
+    current = nextThread();
+    sliceTicks = 0;
+    switchCount++;
+    runStart = now;
+    sp = threads[current].sp;
+    restoreInterrupts(mask);
+    return sp;
+}
+
+// Ask PendSV for a switch if a thread of higher priority than the current one is ready
+void preempt(uint8_t thread)
+{
+    if (current == NO_THREAD || threads[thread].priority < threads[current].priority)
+        NVIC_INT_CTRL_R = NVIC_INT_CTRL_PEND_SV;
+}
+
+// Timer service callback, every ms from the SysTick interrupt
+void tickKernel()
+{
+    uint8_t i;
+    for (i = 0; i < threadCount; i++)
+    {
+        if (threads[i].state == THREAD_DELAYED && --threads[i].ticks == 0)
+        {
+            threads[i].state = THREAD_READY;
+            preempt(i);
+        }
+        else if (threads[i].state == THREAD_BLOCKED && threads[i].ticks != 0 && --threads[i].ticks == 0)
+        {
+            threads[i].semaphore = 0;
+            threads[i].timedOut = true;
+            threads[i].state = THREAD_READY;
+            preempt(i);
+        }
+    }
+    if (++sliceTicks >= KERNEL_SLICE_MS)
+        NVIC_INT_CTRL_R = NVIC_INT_CTRL_PEND_SV;
+}
+
+// Run the threads; does not return
+// The caller moves to a small stack of its own, and the first PendSV discards its
+// frame and starts the highest priority thread. Handlers keep the main stack.
+void startKernel()
+{
+    NVIC_CPAC_R |= NVIC_CPAC_CP10_FULL | NVIC_CPAC_CP11_FULL;
+    NVIC_FPCC_R |= NVIC_FPCC_ASPEN | NVIC_FPCC_LSPEN;   // stack S0-S15 only if a handler uses the FPU
+    NVIC_SYS_PRI3_R = (NVIC_SYS_PRI3_R & ~NVIC_SYS_PRI3_PENDSV_M) | PENDSV_LOWEST;
+    startPeriodicTimer(tickKernel, 1);
+    setPsp((uint32_t)&startStack[START_STACK_WORDS / 2]);
+    usePsp();
+    NVIC_INT_CTRL_R = NVIC_INT_CTRL_PEND_SV;
+    while (true);
+}
+
+// Give the rest of the time slice to a thread of the same priority
+void yield()
+{
+    NVIC_INT_CTRL_R = NVIC_INT_CTRL_PEND_SV;
+}
+
+// Block the current thread for the given number of ms
+void sleep(uint32_t ms)
+{
+    uint32_t mask = disableInterrupts();
+    if (ms != 0)
+    {
+        threads[current].ticks = ms;
+        threads[current].state = THREAD_DELAYED;
+    }
+    NVIC_INT_CTRL_R = NVIC_INT_CTRL_PEND_SV;
+    restoreInterrupts(mask);
+}
+
+void initSemaphore(SEMAPHORE* semaphore, uint16_t count)
+{
+    semaphore->count = count;
+}
+
+// Take a count of the semaphore, blocking until there is one
+void wait(SEMAPHORE* semaphore)
+{
+    waitTimeout(semaphore, 0);
+}
+
+// Take a count of the semaphore, blocking for at most ms (0 for no limit)
+// Returns false if the time ran out first
+bool waitTimeout(SEMAPHORE* semaphore, uint32_t ms)
+{
+    bool taken = true;
+    uint32_t mask = disableInterrupts();
+    if (semaphore->count > 0)
+        semaphore->count--;
+    else
+    {
+        threads[current].semaphore = semaphore;
+        threads[current].ticks = ms;
+        threads[current].timedOut = false;
+        threads[current].state = THREAD_BLOCKED;
+        NVIC_INT_CTRL_R = NVIC_INT_CTRL_PEND_SV;
+        restoreInterrupts(mask);                // switched out here until posted or timed out
+        mask = disableInterrupts();
+        taken = !threads[current].timedOut;
+    }
+    restoreInterrupts(mask);
+    return taken;
+}
+
+// Give a count to the semaphore, or hand it straight to the waiting thread of the
+// highest priority; safe to call from interrupts
+void post(SEMAPHORE* semaphore)
+{
+    uint8_t i, best = NO_THREAD;
+    uint32_t mask = disableInterrupts();
+    for (i = 0; i < threadCount; i++)
+    {
+        if (threads[i].state == THREAD_BLOCKED && threads[i].semaphore == semaphore
+                && (best == NO_THREAD || threads[i].priority < threads[best].priority))
+            best = i;
+    }
+    if (best == NO_THREAD)
+        semaphore->count++;
+    else
+    {
+        threads[best].semaphore = 0;
+        threads[best].ticks = 0;
+        threads[best].state = THREAD_READY;
+        preempt(best);
+    }
+    restoreInterrupts(mask);
+}
+
+void initQueue(QUEUE* queue)
+{
+    queue->read = 0;
+    queue->write = 0;
+    initSemaphore(&queue->items, 0);
+}
+
+// Add a message without blocking; false if the queue is full
+// Safe to call from interrupts
+bool queueSend(QUEUE* queue, uint32_t message)
+{
+    uint32_t mask = disableInterrupts();
+    uint8_t next = (queue->write + 1) % QUEUE_SIZE;
+    if (next == queue->read)
+    {
+        restoreInterrupts(mask);
+        return false;
+    }
+    queue->data[queue->write] = message;
+    queue->write = next;
+    post(&queue->items);
+    restoreInterrupts(mask);
+    return true;
+}
+
+// Take the oldest message, blocking until there is one
+uint32_t queueReceive(QUEUE* queue)
+{
+    uint32_t message;
+    uint32_t mask;
+    wait(&queue->items);
+    mask = disableInterrupts();
+    message = queue->data[queue->read];
+    queue->read = (queue->read + 1) % QUEUE_SIZE;
+    restoreInterrupts(mask);
+    return message;
+}
+
+// Take the oldest message, blocking for at most ms (0 for no limit)
+// Returns false if no message arrived in time
+bool queueReceiveTimeout(QUEUE* queue, uint32_t* message, uint32_t ms)
+{
+    uint32_t mask;
+    if (!waitTimeout(&queue->items, ms))
+        return false;
+    mask = disableInterrupts();
+    *message = queue->data[queue->read];
+    queue->read = (queue->read + 1) % QUEUE_SIZE;
+    restoreInterrupts(mask);
+    return true;
+}
+
+// Take the oldest message if there is one
+bool queueTryReceive(QUEUE* queue, uint32_t* message)
+{
+    uint32_t mask = disableInterrupts();
+    if (queue->items.count == 0)
+    {
+        restoreInterrupts(mask);
+        return false;
+    }
+    queue->items.count--;
+    *message = queue->data[queue->read];
+    queue->read = (queue->read + 1) % QUEUE_SIZE;
+    restoreInterrupts(mask);
+    return true;
+}
+
+uint8_t getThreadCount()
+{
+    return threadCount;
+}
+
+char* getThreadName(uint8_t thread)
+{
+    return threads[thread].name;
+}
+
+uint8_t getThreadPriority(uint8_t thread)
+{
+    return threads[thread].priority;
+}
+
+uint8_t getThreadState(uint8_t thread)
+{
+    return threads[thread].state;
+}
+
+uint32_t getThreadRuns(uint8_t thread)
+{
+    return threads[thread].runs;
+}
+
+// Returns the longest run of a thread from wake-up to blocking, in us
+uint32_t getThreadWcet(uint8_t thread)
+{
+    return threads[thread].wcet / CYCLES_PER_US;
+}
+
+// Returns the most stack the thread has used, in bytes
+uint32_t getThreadStackUsed(uint8_t thread)
+{
+    uint32_t i = 0;
+    while (i < threads[thread].stackWords && threads[thread].stack[i] == STACK_PAINT)
+        i++;
+    return (threads[thread].stackWords - i) * 4;
+}
+
+// Returns the share of the CPU the thread used since the statistics were reset,
+// in tenths of a percent
+uint32_t getThreadCpu(uint8_t thread)
+{
+    if (totalCycles == 0)
+        return 0;
+    return threads[thread].cycles * 1000 / totalCycles;
+}
+
+uint32_t getSwitchCount()
+{
+    return switchCount;
+}
+
+void resetThreadStats()
+{
+    uint8_t i;
+    uint32_t mask = disableInterrupts();
+    for (i = 0; i < threadCount; i++)
+    {
+        threads[i].runs = 0;
+        threads[i].wcet = 0;
+        threads[i].cycles = 0;
+    }
+    totalCycles = 0;
+    switchCount = 0;
+    restoreInterrupts(mask);
+}
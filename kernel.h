@@ -0,0 +1,92 @@
+// Kernel Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// PendSV:
+//   Switches threads at the lowest exception priority (context.asm)
+// SysTick:
+//   The 1 ms tick of the timer service wakes sleeping threads and ends time slices
+// DWT:
+//   The cycle counter times every thread
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef KERNEL_H_
+#define KERNEL_H_
+
+#define MAX_THREADS       8
+#define NO_THREAD         0xFF
+#define KERNEL_HEAP_BYTES 6144      // stacks of all threads
+#define KERNEL_SLICE_MS   10        // round robin between threads of equal priority
+#define QUEUE_SIZE        8
+
+// Thread states
+#define THREAD_INVALID 0
+#define THREAD_READY   1
+#define THREAD_DELAYED 2            // sleeping for a number of ticks
+#define THREAD_BLOCKED 3            // waiting on a semaphore, possibly with a timeout
+#define THREAD_STOPPED 4            // returned from its function
+
+typedef void (*_fn)(void);
+
+typedef struct _SEMAPHORE
+{
+    volatile uint16_t count;
+} SEMAPHORE;
+
+// Message queue of 32-bit messages
+typedef struct _QUEUE
+{
+    uint32_t data[QUEUE_SIZE];
+    uint8_t read;
+    uint8_t write;
+    SEMAPHORE items;
+} QUEUE;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+bool createThread(_fn fn, char* name, uint8_t priority, uint32_t stackBytes);
+void startKernel(void);
+void yield(void);
+void sleep(uint32_t ms);
+void initSemaphore(SEMAPHORE* semaphore, uint16_t count);
+void wait(SEMAPHORE* semaphore);
+bool waitTimeout(SEMAPHORE* semaphore, uint32_t ms);
+void post(SEMAPHORE* semaphore);
+void initQueue(QUEUE* queue);
+bool queueSend(QUEUE* queue, uint32_t message);
+uint32_t queueReceive(QUEUE* queue);
+bool queueReceiveTimeout(QUEUE* queue, uint32_t* message, uint32_t ms);
+bool queueTryReceive(QUEUE* queue, uint32_t* message);
+uint8_t getThreadCount(void);
+char* getThreadName(uint8_t thread);
+uint8_t getThreadPriority(uint8_t thread);
+uint8_t getThreadState(uint8_t thread);
+uint32_t getThreadRuns(uint8_t thread);
+uint32_t getThreadWcet(uint8_t thread);
+uint32_t getThreadStackUsed(uint8_t thread);
+uint32_t getThreadCpu(uint8_t thread);
+uint32_t getSwitchCount(void);
+void resetThreadStats(void);
+uint32_t switchContext(uint32_t sp);
+
+// context.asm
+void pendSvIsr(void);
+void setPsp(uint32_t sp);
+void usePsp(void);
+uint32_t disableInterrupts(void);
+void restoreInterrupts(uint32_t mask);
+
+#endif
@@ -0,0 +1,290 @@
+// Map Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Uses the motion and ultrasonic libraries
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "odometry.h"
+#include "kernel.h"
+#include "motion.h"
+#include "ultrasonic.h"
+#include "uart0.h"
+#include "map.h"
+
+#define LOW_BITS 0x55555555     // low bit of every cell in a word
+
+// Grid coordinates: x to the right, y down, heading 0 along +x and clockwise positive
+typedef struct _POSE
+{
+    int32_t x;              // um from the start
+    int32_t y;
+    int32_t heading;        // tenths of a degree, 0 to 3599
+    int32_t travel[2];      // wheel travel at the last update, ticks
+    int32_t origin;         // left - right travel when the map was cleared
+} POSE;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+uint32_t mapGrid[MAP_SIZE][MAP_WORDS];      // 4 KB
+POSE pose;
+uint32_t mapSequence[RANGE_SENSORS];        // last reading of each sensor put in the map
+
+// Bearing of each sensor from the heading, tenths of a degree clockwise
+const int16_t sensorBearing[RANGE_SENSORS] = {0, 2700, 900, 1800};
+
+// sin of 0 to 90 degrees, Q14
+const int16_t sinTable[91] =
+{
+    0, 286, 572, 857, 1143, 1428, 1713, 1997, 2280, 2563,
+    2845, 3126, 3406, 3686, 3964, 4240, 4516, 4790, 5063, 5334,
+    5604, 5872, 6138, 6402, 6664, 6924, 7182, 7438, 7692, 7943,
+    8192, 8438, 8682, 8923, 9162, 9397, 9630, 9860, 10087, 10311,
+    10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+    12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+    14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+    15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+    16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+    16384
+};
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+int32_t wrapAngle(int32_t angle)
+{
+    angle %= 3600;
+    return angle < 0 ? angle + 3600 : angle;
+}
+
+// Returns sin of an angle in tenths of a degree, Q14, interpolated between degrees
+int32_t sinDecideg(int32_t angle)
+{
+    int32_t quadrant, a, deg, frac, s;
+    angle = wrapAngle(angle);
+    quadrant = angle / 900;
+    a = angle % 900;
+    if (quadrant & 1)
+        a = 900 - a;
+    deg = a / 10;
+    frac = a % 10;
+    s = sinTable[deg];
+    if (frac != 0)
+        s += (sinTable[deg + 1] - s) * frac / 10;
+    return quadrant >= 2 ? -s : s;
+}
+
+int32_t cosDecideg(int32_t angle)
+{
+    return sinDecideg(angle + 900);
+}
+
+// Forget the map and put the robot back in the middle, heading along +x
+void clearMap()
+{
+    uint8_t y, w;
+    for (y = 0; y < MAP_SIZE; y++)
+        for (w = 0; w < MAP_WORDS; w++)
+            mapGrid[y][w] = LOW_BITS;          // every cell CELL_UNKNOWN
+    pose.x = 0;
+    pose.y = 0;
+    pose.heading = 0;
+    pose.travel[MOTOR_LEFT] = getWheelTravel(MOTOR_LEFT);
+    pose.travel[MOTOR_RIGHT] = getWheelTravel(MOTOR_RIGHT);
+    pose.origin = pose.travel[MOTOR_LEFT] - pose.travel[MOTOR_RIGHT];
+    for (y = 0; y < RANGE_SENSORS; y++)
+        mapSequence[y] = getRangeSequence(y);
+}
+
+// Integrate the wheel travel since the last update
+// The heading is taken from the total difference of the wheels, so it does not
+// drift with the number of updates; the distance is applied along the mean heading
+void updatePose()
+{
+    int32_t left = getWheelTravel(MOTOR_LEFT), right = getWheelTravel(MOTOR_RIGHT);
+    int32_t ds, heading, mean;
+    ds = ((left - pose.travel[MOTOR_LEFT]) + (right - pose.travel[MOTOR_RIGHT])) * ODO_UM_PER_TICK / 2;
+    heading = wrapAngle((left - right - pose.origin) * MAP_DECIDEG_PER_2TICKS / 2);
+    mean = pose.heading + wrapAngle(heading - pose.heading + 1800) / 2 - 900;
+    pose.x += ((int64_t)ds * cosDecideg(mean)) >> 14;
+    pose.y += ((int64_t)ds * sinDecideg(mean)) >> 14;
+    pose.heading = heading;
+    pose.travel[MOTOR_LEFT] = left;
+    pose.travel[MOTOR_RIGHT] = right;
+}
+
+// Returns the pose in mm and tenths of a degree
+void getPose(int32_t *x, int32_t *y, uint16_t *heading)
+{
+    *x = pose.x / 1000;
+    *y = pose.y / 1000;
+    *heading = pose.heading;
+}
+
+// Converts a position in mm to a cell index, which may be outside the grid
+int16_t mmToCell(int32_t mm)
+{
+    mm += MAP_SIZE / 2 * MAP_CELL_MM;
+    if (mm < 0)
+        return (mm - MAP_CELL_MM + 1) / MAP_CELL_MM;
+    return mm / MAP_CELL_MM;
+}
+
+bool inMap(int16_t x, int16_t y)
+{
+    return x >= 0 && x < MAP_SIZE && y >= 0 && y < MAP_SIZE;
+}
+
+uint8_t getMapCell(uint8_t x, uint8_t y)
+{
+    return (mapGrid[y][x >> 4] >> ((x & 15) * 2)) & 3;
+}
+
+// Decrement every cell of a word selected by the low-bit mask, saturating at 0
+// A cell is non-zero if either of its bits is set, so only those get a 1 subtracted
+// and no borrow can cross into the next cell
+void missCells(uint8_t y, uint8_t w, uint32_t mask)
+{
+    uint32_t v = mapGrid[y][w];
+    uint32_t nonZero = (v | (v >> 1)) & LOW_BITS;
+    mapGrid[y][w] = v - (nonZero & mask);
+}
+
+// Add 2 to a cell, saturating at CELL_OCCUPIED
+void hitCell(uint8_t x, uint8_t y)
+{
+    uint8_t shift = (x & 15) * 2;
+    uint32_t v = mapGrid[y][x >> 4];
+    uint32_t cell = (v >> shift) & 3;
+    cell = cell + 2 > CELL_OCCUPIED ? CELL_OCCUPIED : cell + 2;
+    mapGrid[y][x >> 4] = (v & ~(3UL << shift)) | (cell << shift);
+}
+
+// Trace a reading from the robot along a bearing
+// Bresenham walks the cells; the cells of a run that fall in one word are collected
+// in a mask and cleared together. The end cell is a hit unless the reading was out
+// of range.
+void castRay(int32_t bearing, uint32_t distance, bool hit)
+{
+    int16_t x0 = mmToCell(pose.x / 1000), y0 = mmToCell(pose.y / 1000);
+    int16_t x1 = mmToCell(pose.x / 1000 + (int32_t)distance * cosDecideg(bearing) / 16384);
+    int16_t y1 = mmToCell(pose.y / 1000 + (int32_t)distance * sinDecideg(bearing) / 16384);
+    int16_t dx, dy, sx, sy, err, e2;
+    int16_t row, word;
+    uint32_t mask = 0;
+
+    if (!inMap(x0, y0))
+        return;
+    dx = x1 > x0 ? x1 - x0 : x0 - x1;
+    dy = y1 > y0 ? y0 - y1 : y1 - y0;
+    sx = x0 < x1 ? 1 : -1;
+    sy = y0 < y1 ? 1 : -1;
+    err = dx + dy;
+    row = y0;
+    word = x0 >> 4;
+
+    while (x0 != x1 || y0 != y1)
+    {
+        if (y0 != row || (x0 >> 4) != word)
+        {
+            missCells(row, word, mask);
+            mask = 0;
+            row = y0;
+            word = x0 >> 4;
+        }
+        mask |= 1UL << ((x0 & 15) * 2);
+        e2 = 2 * err;
+        if (e2 >= dy)
+        {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx)
+        {
+            err += dx;
+            y0 += sy;
+        }
+        if (!inMap(x0, y0))
+        {
+            hit = false;
+            break;
+        }
+    }
+    if (mask != 0)
+        missCells(row, word, mask);
+    if (hit)
+        hitCell(x0, y0);
+}
+
+// Put every reading published since the last call into the map
+// Called from the background loops; one ray is a few hundred cycles at most
+void updateMap()
+{
+    uint32_t sequence, distance;
+    uint8_t i, status;
+    updatePose();
+    for (i = 0; i < RANGE_SENSORS; i++)
+    {
+        sequence = getRangeSequence(i);
+        if (sequence == mapSequence[i])
+            continue;
+        mapSequence[i] = sequence;
+        status = getRangeStatus(i);
+        if (status == RANGE_NO_OBJECT)
+            castRay(pose.heading + sensorBearing[i], MAP_MAX_RANGE_MM, false);
+        else if (status == RANGE_OK && isRangeValid(i))
+        {
+            distance = getRangeDistance(i);
+            if (distance > MAP_MAX_RANGE_MM)
+                castRay(pose.heading + sensorBearing[i], MAP_MAX_RANGE_MM, false);
+            else
+                castRay(pose.heading + sensorBearing[i], distance, true);
+        }
+    }
+}
+
+// Send the grid run-length encoded, row by row
+// 'M', 'P', the grid size, then one byte per run: the cell value in the top two bits
+// and the run length - 1 (up to 64 cells) in the low six bits
+// A row is at most MAP_SIZE bytes (11 ms at 115200 baud); the thread sleeps after
+// each one, so the idle thread feeds the watchdog during the 1.4 s of a worst-case grid
+// Call from a thread only
+void streamMap()
+{
+    uint8_t x, y, value, run = 0, last = 0;
+    putcUart0('M');
+    putcUart0('P');
+    putcUart0(MAP_SIZE);
+    for (y = 0; y < MAP_SIZE; y++)
+    {
+        for (x = 0; x < MAP_SIZE; x++)
+        {
+            value = getMapCell(x, y);
+            if (run != 0 && (value != last || run == 64))
+            {
+                putcUart0((last << 6) | (run - 1));
+                run = 0;
+            }
+            last = value;
+            run++;
+        }
+        sleep(MAP_ROW_PAUSE_MS);
+    }
+    putcUart0((last << 6) | (run - 1));
+}
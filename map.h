@@ -0,0 +1,51 @@
+// Map Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Uses the motion and ultrasonic libraries
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef MAP_H_
+#define MAP_H_
+
+// Grid of 2-bit cells, 16 cells per word, the robot starts in the middle
+#define MAP_SIZE         128
+#define MAP_CELL_MM      50
+#define MAP_WORDS        (MAP_SIZE / 16)
+#define MAP_MAX_RANGE_MM 3000   // longer readings only clear cells up to here
+#define MAP_ROW_PAUSE_MS 2      // sleep after every streamed row, at least one full tick
+
+// Cell values, a saturating log-odds scale
+// A hit adds 2 and a ray passing through subtracts 1, so a single hit marks an
+// unknown cell occupied and three misses clear it again
+#define CELL_FREE     0
+#define CELL_UNKNOWN  1
+#define CELL_LIKELY   2
+#define CELL_OCCUPIED 3
+
+// Wheel geometry, from 20 ticks of each wheel per 90 degree turn
+#define MAP_DECIDEG_PER_2TICKS 45   // heading change per tick of difference between the wheels, x2
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void clearMap(void);
+void updatePose(void);
+void updateMap(void);
+void getPose(int32_t *x, int32_t *y, uint16_t *heading);
+uint8_t getMapCell(uint8_t x, uint8_t y);
+void streamMap(void);
+
+#endif
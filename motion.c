@@ -0,0 +1,410 @@
+// Motion Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Right motor:
+//   M0PWM2 (PB4) and M0PWM3 (PB5), PWM0 generator 1, sensed by odometry wheel 1
+// Left motor:
+//   M0PWM4 (PE4) and M0PWM5 (PE5), PWM0 generator 2, sensed by odometry wheel 0
+// Profile timer:
+//   TIMER2A interrupts at MOTION_RATE_HZ
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "battery.h"
+#include "clock.h"
+#include "odometry.h"
+#include "pwm.h"
+#include "motion.h"
+
+// Speed feedback gain, in normalized duty per mm/s of error
+#define KP_NUM 16
+#define KP_DEN 1
+
+typedef struct _MOTION
+{
+    int8_t dir[2];          // +1 forward, -1 reverse, per motor
+    uint32_t target;        // ticks per wheel, 0 to run until stopped
+    bool active;            // profile is running
+    bool stopping;          // ramping down to idle
+    int32_t speed;          // commanded speed, um/s
+    int32_t accel;          // commanded acceleration, um/s^2
+    uint8_t stopMode;       // STOP_COAST or STOP_BRAKE
+    uint16_t brake[2];      // brake periods left, per motor
+    bool cut[2];            // motor has been turned off
+    uint32_t cutTicks[2];   // odometry ticks when the motor was turned off
+    int32_t travel[2];      // signed ticks since power up, per motor
+    uint32_t counted[2];    // odometry ticks already added to travel
+} MOTION;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+volatile MOTION motion;
+uint32_t motionSpeed = MOTION_DEFAULT_SPEED;
+uint32_t motionAccel = MOTION_DEFAULT_ACCEL;
+uint32_t motionDecel = MOTION_DEFAULT_DECEL;
+uint32_t motionJerk = MOTION_DEFAULT_JERK;
+uint8_t stopMode = STOP_COAST;
+uint16_t brakeTime = MOTION_DEFAULT_BRAKE_MS;
+const uint16_t maxDuty[2] = {MOTOR_MAX_DUTY_LEFT, MOTOR_MAX_DUTY_RIGHT};
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Start the profile timer
+void initMotion()
+{
+    SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R2;
+    _delay_cycles(3);
+
+    TIMER2_CTL_R &= ~TIMER_CTL_TAEN;                    // turn-off timer before reconfiguring
+    TIMER2_CFG_R = TIMER_CFG_32_BIT_TIMER;              // configure as 32-bit timer (A+B)
+    TIMER2_TAMR_R = TIMER_TAMR_TAMR_PERIOD;             // configure for periodic mode (count down)
+    TIMER2_TAILR_R = getSystemClock() / MOTION_RATE_HZ;
+    TIMER2_IMR_R = TIMER_IMR_TATOIM;                    // turn-on interrupts
+    NVIC_EN0_R |= 1 << (INT_TIMER2A-16);
+    TIMER2_CTL_R |= TIMER_CTL_TAEN;
+}
+
+// Reload the profile timer for MOTION_RATE_HZ after the system clock changed
+void updateMotionClock()
+{
+    TIMER2_TAILR_R = getSystemClock() / MOTION_RATE_HZ;
+}
+
+// Stage the output of one motor; duty is normalized, direction +1 forward or -1 reverse
+// The right motor is on generator 1 (B forward), the left on generator 2 (A forward)
+void setMotorOutput(uint8_t motor, int8_t dir, uint16_t duty)
+{
+    if (motor == MOTOR_RIGHT)
+        setPwmDuty(1, dir < 0 ? duty : 0, dir > 0 ? duty : 0);
+    else
+        setPwmDuty(2, dir > 0 ? duty : 0, dir < 0 ? duty : 0);
+}
+
+// Stage both inputs of a motor high so the H-bridge brakes it
+void setMotorBrake(uint8_t motor)
+{
+    setPwmDuty(motor == MOTOR_RIGHT ? 1 : 2, MOTOR_BRAKE_DUTY, MOTOR_BRAKE_DUTY);
+}
+
+// Arm the stop of the current move; STOP_DEFAULT uses the global stop mode
+void armStop(uint8_t mode)
+{
+    uint8_t i;
+    motion.stopMode = mode == STOP_DEFAULT ? stopMode : mode;
+    for (i = 0; i < 2; i++)
+    {
+        motion.brake[i] = motion.stopMode == STOP_BRAKE ? brakeTime * (MOTION_RATE_HZ / 1000) : 0;
+        motion.cut[i] = false;
+    }
+}
+
+// Add the ticks since the last call to the signed travel of each motor
+// A wheel that rolls out after a move still counts in the direction of that move
+void updateTravel()
+{
+    uint32_t ticks;
+    uint8_t i;
+    for (i = 0; i < 2; i++)
+    {
+        ticks = getOdometryTicks(i);
+        motion.travel[i] += motion.dir[i] * (int32_t)(ticks - motion.counted[i]);
+        motion.counted[i] = ticks;
+    }
+}
+
+// Returns the signed travel of a motor in ticks, forward positive
+int32_t getWheelTravel(uint8_t motor)
+{
+    return motion.travel[motor];
+}
+
+// Start a move of the given number of ticks on each wheel (0 runs until stopped)
+// Directions are +1 forward or -1 reverse for each motor
+void startMove(int8_t leftDir, int8_t rightDir, uint32_t ticks, uint8_t mode)
+{
+    TIMER2_IMR_R &= ~TIMER_IMR_TATOIM;                  // keep the profile out while we set up
+    updateTravel();                                     // ticks so far belong to the old directions
+    if (!motion.active || motion.dir[MOTOR_LEFT] != leftDir || motion.dir[MOTOR_RIGHT] != rightDir)
+    {
+        motion.speed = 0;
+        motion.accel = 0;
+    }
+    motion.dir[MOTOR_LEFT] = leftDir;
+    motion.dir[MOTOR_RIGHT] = rightDir;
+    motion.target = ticks;
+    motion.stopping = false;
+    armStop(mode);
+    motion.active = true;
+    resetOdometry();
+    motion.counted[MOTOR_LEFT] = 0;
+    motion.counted[MOTOR_RIGHT] = 0;
+    TIMER2_IMR_R |= TIMER_IMR_TATOIM;
+}
+
+// Ramp down to a stop with the deceleration limit
+void stopMove(uint8_t mode)
+{
+    TIMER2_IMR_R &= ~TIMER_IMR_TATOIM;
+    armStop(mode);
+    motion.stopping = true;
+    TIMER2_IMR_R |= TIMER_IMR_TATOIM;
+}
+
+// Turn both motors off at once and abandon the profile
+void haltMotors()
+{
+    motion.active = false;
+    motion.speed = 0;
+    motion.accel = 0;
+    setMotorOutput(MOTOR_LEFT, 0, 0);
+    setMotorOutput(MOTOR_RIGHT, 0, 0);
+    commitPwm();
+}
+
+bool isMoving()
+{
+    return motion.active;
+}
+
+// Returns true while both wheels are driven forward
+bool isMovingForward()
+{
+    return motion.active && motion.dir[MOTOR_LEFT] > 0 && motion.dir[MOTOR_RIGHT] > 0;
+}
+
+// Returns the stop mode used by the last move
+uint8_t getLastStopMode()
+{
+    return motion.stopMode;
+}
+
+// Returns the distance rolled since the motors of the last move were turned off,
+// averaged over both wheels, in mm
+uint32_t getStopDistance()
+{
+    uint32_t ticks = 0;
+    uint8_t i;
+    for (i = 0; i < 2; i++)
+        if (motion.cut[i])
+            ticks += getOdometryTicks(i) - motion.cutTicks[i];
+    return ticks * ODO_UM_PER_TICK / 2000;
+}
+
+void setStopMode(uint8_t mode)
+{
+    if (mode == STOP_COAST || mode == STOP_BRAKE)
+        stopMode = mode;
+}
+
+void setBrakeTime(uint16_t ms)
+{
+    brakeTime = ms;
+}
+
+// Returns the profile speed in mm/s
+uint32_t getMotionSpeed()
+{
+    return motion.speed / 1000;
+}
+
+// Returns the cruise speed setting in mm/s
+uint32_t getMotionCruise()
+{
+    return motionSpeed;
+}
+
+// A cruise speed of 0 would leave a move at the friction duty forever, and the
+// wheels cannot go faster than MOTION_MAX_SPEED at full duty
+bool setMotionSpeed(uint32_t speed)
+{
+    if (speed == 0 || speed > MOTION_MAX_SPEED)
+        return false;
+    motionSpeed = speed;
+    return true;
+}
+
+// Limited to MOTION_MAX_ACCEL
+bool setMotionAccel(uint32_t accel)
+{
+    if (accel == 0)
+        return false;
+    motionAccel = accel > MOTION_MAX_ACCEL ? MOTION_MAX_ACCEL : accel;
+    return true;
+}
+
+// Limited to MOTION_MAX_ACCEL, so 2 * decel * MOTION_BRAKE_RANGE_MM fits in 32 bits
+bool setMotionDecel(uint32_t decel)
+{
+    if (decel == 0)
+        return false;
+    motionDecel = decel > MOTION_MAX_ACCEL ? MOTION_MAX_ACCEL : decel;
+    return true;
+}
+
+// Below MOTION_RATE_HZ the acceleration of the first profile period is under
+// 1 mm/s^2 and the speed would not change in um/s; limited to MOTION_MAX_JERK
+bool setMotionJerk(uint32_t jerk)
+{
+    if (jerk < MOTION_RATE_HZ)
+        return false;
+    motionJerk = jerk > MOTION_MAX_JERK ? MOTION_MAX_JERK : jerk;
+    return true;
+}
+
+uint32_t isqrt(uint32_t x)
+{
+    uint32_t root = 0, bit = 1UL << 30;
+    while (bit > x)
+        bit >>= 2;
+    while (bit != 0)
+    {
+        if (x >= root + bit)
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+            root >>= 1;
+        bit >>= 2;
+    }
+    return root;
+}
+
+// Profile generator, runs at MOTION_RATE_HZ
+// The speed ramps with the acceleration limit, and the change in acceleration is
+// limited by the jerk. For a move with a target, the speed is also capped at the
+// speed from which the deceleration limit stops the robot in the distance left to
+// the target tick, minus the distance covered while the jerk limit builds up the
+// deceleration; so the ramp down ends on the target tick
+void motionIsr()
+{
+    int32_t vTarget, aTarget, aStep, easing, vLimit = 0x7FFFFFFF;
+    uint32_t ticks[2], remaining, lead, left;
+    uint16_t duty;
+    int32_t error, limit;
+    uint32_t gain;
+    bool idle;
+    uint8_t i;
+
+    TIMER2_ICR_R = TIMER_ICR_TATOCINT;
+    updateTravel();
+    if (!motion.active)
+        return;
+
+    ticks[MOTOR_LEFT] = getOdometryTicks(MOTOR_LEFT);
+    ticks[MOTOR_RIGHT] = getOdometryTicks(MOTOR_RIGHT);
+
+    vTarget = motion.stopping ? 0 : motionSpeed * 1000;
+    if (motion.target != 0)
+    {
+        left = ticks[MOTOR_LEFT] < ticks[MOTOR_RIGHT] ? ticks[MOTOR_LEFT] : ticks[MOTOR_RIGHT];
+        if (left >= motion.target)
+            vLimit = 0;
+        else
+        {
+            remaining = (motion.target - left) * ODO_UM_PER_TICK / 1000;
+            if (remaining > MOTION_BRAKE_RANGE_MM)
+                remaining = MOTION_BRAKE_RANGE_MM;
+            lead = (motion.speed / 1000) * motionDecel / (2 * motionJerk);
+            vLimit = isqrt(2 * motionDecel * (remaining > lead ? remaining - lead : 0)) * 1000;
+            if (vLimit < MOTION_MIN_SPEED * 1000)
+                vLimit = MOTION_MIN_SPEED * 1000;
+        }
+        if (vTarget > vLimit)
+            vTarget = vLimit;
+    }
+
+    // Ease the acceleration out before reaching the target speed
+    if (vTarget > motion.speed)
+    {
+        aTarget = motionAccel * 1000;
+        easing = (motion.accel / 1000) * (motion.accel / 1000) / (2 * motionJerk) * 1000;
+        if (motion.accel > 0 && vTarget - motion.speed <= easing)
+            aTarget = 0;
+    }
+    else if (vTarget < motion.speed)
+        aTarget = -(int32_t)motionDecel * 1000;
+    else
+        aTarget = 0;
+
+    aStep = motionJerk * 1000 / MOTION_RATE_HZ;
+    if (motion.accel + aStep < aTarget)
+        motion.accel += aStep;
+    else if (motion.accel - aStep > aTarget)
+        motion.accel -= aStep;
+    else
+        motion.accel = aTarget;
+
+    motion.speed += motion.accel / MOTION_RATE_HZ;
+    if ((motion.accel > 0 && motion.speed > vTarget) || (motion.accel < 0 && motion.speed < vTarget))
+    {
+        motion.speed = vTarget;
+        motion.accel = 0;
+    }
+    if (motion.speed > vLimit)
+        motion.speed = vLimit;
+    if (motion.speed < 0)
+        motion.speed = 0;
+
+    // Feedforward from the profile speed plus a correction from the measured speed,
+    // scaled by the battery so the motor voltage is the one the model was trimmed at
+    // A motor that is done, because the ramp down of a stop ended or its wheel reached
+    // the target, brakes for the brake time or coasts, and the move ends once both
+    // motors are off. A speed of 0 alone is not the end: it is also the first period
+    // of a ramp up
+    gain = getBatteryGain();
+    idle = true;
+    for (i = 0; i < 2; i++)
+    {
+        if ((motion.stopping && motion.speed == 0) || (motion.target != 0 && ticks[i] >= motion.target))
+        {
+            if (!motion.cut[i])
+            {
+                motion.cut[i] = true;
+                motion.cutTicks[i] = ticks[i];
+            }
+            if (motion.brake[i] > 0)
+            {
+                motion.brake[i]--;
+                setMotorBrake(i);
+                idle = false;
+            }
+            else
+                setMotorOutput(i, 0, 0);
+            continue;
+        }
+        error = motion.speed / 1000 - (int32_t)getWheelSpeed(i);
+        error = MOTOR_MIN_DUTY + (motion.speed / 1000) * (maxDuty[i] - MOTOR_MIN_DUTY) / MOTION_MAX_SPEED
+                + error * KP_NUM / KP_DEN;
+        error = error * (int32_t)gain >> BATTERY_GAIN_SHIFT;
+        limit = maxDuty[i] * gain >> BATTERY_GAIN_SHIFT;
+        if (limit > PWM_DUTY_MAX)
+            limit = PWM_DUTY_MAX;
+        if (error > limit)
+            error = limit;
+        duty = error > 0 ? error : 0;
+        setMotorOutput(i, motion.dir[i], duty);
+        idle = false;
+    }
+    commitPwm();
+    if (idle)
+        motion.active = false;
+}
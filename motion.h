@@ -0,0 +1,81 @@
+// Motion Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Right motor:
+//   M0PWM2 (PB4) and M0PWM3 (PB5), PWM0 generator 1, sensed by odometry wheel 1
+// Left motor:
+//   M0PWM4 (PE4) and M0PWM5 (PE5), PWM0 generator 2, sensed by odometry wheel 0
+// Profile timer:
+//   TIMER2A interrupts at MOTION_RATE_HZ
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef MOTION_H_
+#define MOTION_H_
+
+#define MOTOR_LEFT  0
+#define MOTOR_RIGHT 1
+
+#define MOTION_RATE_HZ 1000
+
+// Stop modes
+#define STOP_DEFAULT 0      // use the global stop mode
+#define STOP_COAST   1      // both half-bridge inputs low, the wheel rolls out
+#define STOP_BRAKE   2      // both half-bridge inputs high for the brake time
+
+// Default profile limits, runtime adjustable
+#define MOTION_DEFAULT_SPEED 300    // cruise speed, mm/s
+#define MOTION_DEFAULT_ACCEL 400    // mm/s^2
+#define MOTION_DEFAULT_DECEL 400    // mm/s^2
+#define MOTION_DEFAULT_JERK  4000   // mm/s^3
+#define MOTION_DEFAULT_BRAKE_MS 150
+
+// Upper limits of the settings; with these the profile math stays in 32 bits
+#define MOTION_MAX_ACCEL     4000   // mm/s^2, also the deceleration limit
+#define MOTION_MAX_JERK      100000 // mm/s^3
+#define MOTION_BRAKE_RANGE_MM 100000 // the braking limit ignores distance beyond this
+
+// Motor model, duties are normalized to PWM_DUTY_MAX (32768) so they hold at any PWM frequency
+#define MOTION_MAX_SPEED     350    // approximate wheel speed at full duty, mm/s
+#define MOTION_MIN_SPEED     40     // crawl speed kept until the target tick, mm/s
+#define MOTOR_MIN_DUTY       11200  // just overcomes friction (34%)
+#define MOTOR_MAX_DUTY_LEFT  31872  // trims so the robot drives straight (97.3%)
+#define MOTOR_MAX_DUTY_RIGHT 32032  // (97.8%)
+#define MOTOR_BRAKE_DUTY     32768  // always high
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initMotion(void);
+void updateMotionClock(void);
+void startMove(int8_t leftDir, int8_t rightDir, uint32_t ticks, uint8_t mode);
+void stopMove(uint8_t mode);
+void haltMotors(void);
+bool isMoving(void);
+bool isMovingForward(void);
+uint8_t getLastStopMode(void);
+uint32_t getStopDistance(void);
+int32_t getWheelTravel(uint8_t motor);
+void setStopMode(uint8_t mode);
+void setBrakeTime(uint16_t ms);
+uint32_t getMotionSpeed(void);
+uint32_t getMotionCruise(void);
+bool setMotionSpeed(uint32_t speed);
+bool setMotionAccel(uint32_t accel);
+bool setMotionDecel(uint32_t decel);
+bool setMotionJerk(uint32_t jerk);
+void motionIsr(void);
+
+#endif
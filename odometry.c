@@ -0,0 +1,349 @@
+// Odometry Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Hall sensor 0:
+//   WT0CCP0 (PC4) senses the magnet on wheel 0
+// Hall sensor 1:
+//   WT1CCP0 (PC6) senses the magnet on wheel 1
+//   Both sensors are open-drain, pulled up, and go low while a magnet is in front
+// Stop timeout:
+//   Periodic timer of the timer service
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "clock.h"
+#include "kernel.h"
+#include "timer.h"
+#include "odometry.h"
+
+// PortC masks
+#define FREQ_IN_MASK_C6 64
+#define FREQ_IN_MASK_C4 16
+
+#define COUNTS_PER_US (getSystemClock() / 1000000)
+
+// speed (mm/s) = SPEED_SCALE / tick period (timer counts)
+#define SPEED_SCALE ((ODO_UM_PER_TICK) * (getSystemClock() / 1000))
+#define STOP_TIMEOUT (ODO_STOP_TIMEOUT_MS * (getSystemClock() / 1000))
+
+typedef struct _ODO_WHEEL
+{
+    uint32_t ticks;         // accepted rising edges
+    uint32_t rejects;       // edges discarded by the glitch filter
+    uint32_t lastTick;      // capture time of the last accepted edge
+    bool timing;            // lastTick is recent enough to measure a period from
+    uint32_t lowStart;      // capture time of the last falling edge
+    bool low;               // sensor output is low (magnet present)
+    uint32_t period[ODO_SPEED_WINDOW];  // most recent tick periods
+    uint8_t periodIndex;
+    uint8_t periodCount;    // valid entries in period[], 0 after a stop
+    uint8_t stopFraction;   // Q8 position fraction while no period is known
+} ODO_WHEEL;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+volatile ODO_WHEEL odoWheels[ODO_WHEELS];
+uint8_t odoMode = ODO_MODE_EDGE_TIME;
+uint32_t odoMinIntervalUs = ODO_DEFAULT_MIN_INTERVAL_US;
+uint32_t odoHysteresisUs = ODO_DEFAULT_HYSTERESIS_US;
+uint32_t odoMinInterval;                // filter in timer counts
+uint32_t odoHysteresis;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Forget the last tick of every wheel that has not ticked for ODO_STOP_TIMEOUT_MS
+// Runs from the timer service well before the capture timer wraps (54 s at 80 MHz),
+// so a parked wheel never measures its age modulo the timer range
+void odometryTimeout()
+{
+    volatile ODO_WHEEL *w;
+    uint32_t now[ODO_WHEELS];
+    uint8_t i;
+
+    if (odoMode != ODO_MODE_EDGE_TIME)
+        return;
+    WTIMER0_IMR_R &= ~TIMER_IMR_CAEIM;
+    WTIMER1_IMR_R &= ~TIMER_IMR_CAEIM;                  // keep the ISRs out while checking
+    now[0] = WTIMER0_TAV_R;
+    now[1] = WTIMER1_TAV_R;
+    for (i = 0; i < ODO_WHEELS; i++)
+    {
+        w = &odoWheels[i];
+        if (w->timing && now[i] - w->lastTick > STOP_TIMEOUT)
+        {
+            w->timing = false;
+            w->periodCount = 0;
+            w->periodIndex = 0;
+            w->stopFraction = 255;                      // held just below the next tick
+        }
+    }
+    WTIMER0_IMR_R |= TIMER_IMR_CAEIM;
+    WTIMER1_IMR_R |= TIMER_IMR_CAEIM;
+}
+
+// Configure both wide timers for the current odometry mode
+void configOdometryTimers()
+{
+    WTIMER0_CTL_R &= ~TIMER_CTL_TAEN;
+    WTIMER1_CTL_R &= ~TIMER_CTL_TAEN;                   // turn-off counters before reconfiguring
+    WTIMER0_CFG_R = 4;
+    WTIMER1_CFG_R = 4;                                  // configure as 32-bit counter (A only)
+    WTIMER0_TAMR_R = TIMER_TAMR_TAMR_CAP | TIMER_TAMR_TACDIR;
+    WTIMER1_TAMR_R = TIMER_TAMR_TAMR_CAP | TIMER_TAMR_TACDIR;
+                                                        // configure for count up, capture
+    WTIMER0_TAILR_R = 0xFFFFFFFF;
+    WTIMER1_TAILR_R = 0xFFFFFFFF;                       // free-run over the full 32-bit range
+    if (odoMode == ODO_MODE_EDGE_TIME)
+    {
+        WTIMER0_TAMR_R |= TIMER_TAMR_TACMR;
+        WTIMER1_TAMR_R |= TIMER_TAMR_TACMR;             // configure edge-time
+        WTIMER0_CTL_R = TIMER_CTL_TAEVENT_BOTH;
+        WTIMER1_CTL_R = TIMER_CTL_TAEVENT_BOTH;         // capture both edges for hysteresis
+        WTIMER0_ICR_R = TIMER_ICR_CAECINT;
+        WTIMER1_ICR_R = TIMER_ICR_CAECINT;
+        WTIMER0_IMR_R = TIMER_IMR_CAEIM;
+        WTIMER1_IMR_R = TIMER_IMR_CAEIM;                // turn-on capture interrupts
+        NVIC_EN2_R |= 1 << (INT_WTIMER0A-16-64);
+        NVIC_EN3_R |= 1 << (INT_WTIMER1A-16-96);
+    }
+    else
+    {
+        WTIMER0_CTL_R = TIMER_CTL_TAEVENT_POS;
+        WTIMER1_CTL_R = TIMER_CTL_TAEVENT_POS;          // configure edge-count on rising edges
+        WTIMER0_IMR_R = 0;
+        WTIMER1_IMR_R = 0;                              // turn-off interrupts
+    }
+    resetOdometry();
+    WTIMER0_CTL_R |= TIMER_CTL_TAEN;
+    WTIMER1_CTL_R |= TIMER_CTL_TAEN;
+}
+
+// Initialize hall sensor inputs and the odometry timers
+void initOdometry()
+{
+    // Enable clocks
+    SYSCTL_RCGCWTIMER_R |= SYSCTL_RCGCWTIMER_R1 | SYSCTL_RCGCWTIMER_R0;
+    SYSCTL_RCGCGPIO_R |= SYSCTL_RCGCGPIO_R2;
+    _delay_cycles(3);
+
+    // PC4 and PC6 for WTIMERS for detecting magnet rotations
+    GPIO_PORTC_AFSEL_R |= FREQ_IN_MASK_C6 | FREQ_IN_MASK_C4;
+    GPIO_PORTC_PCTL_R &= ~(GPIO_PCTL_PC6_M | GPIO_PCTL_PC4_M);
+    GPIO_PORTC_PCTL_R |= GPIO_PCTL_PC6_WT1CCP0 | GPIO_PCTL_PC4_WT0CCP0;
+    GPIO_PORTC_PUR_R |= FREQ_IN_MASK_C6 | FREQ_IN_MASK_C4;
+    GPIO_PORTC_DEN_R |= FREQ_IN_MASK_C6 | FREQ_IN_MASK_C4;
+
+    setOdometryFilter(odoMinIntervalUs, odoHysteresisUs);
+    configOdometryTimers();
+    startPeriodicTimer(odometryTimeout, ODO_STOP_TIMEOUT_MS);
+}
+
+// Select edge-count or edge-time input mode
+void setOdometryMode(uint8_t mode)
+{
+    odoMode = mode;
+    configOdometryTimers();
+}
+
+// Set the shortest accepted tick period and the minimum low time before a tick
+void setOdometryFilter(uint32_t minIntervalUs, uint32_t hysteresisUs)
+{
+    odoMinIntervalUs = minIntervalUs;
+    odoHysteresisUs = hysteresisUs;
+    odoMinInterval = minIntervalUs * COUNTS_PER_US;
+    odoHysteresis = hysteresisUs * COUNTS_PER_US;
+}
+
+// Convert the filter to the new system clock and drop the tick periods measured with the old one
+void updateOdometryClock()
+{
+    uint8_t i;
+    setOdometryFilter(odoMinIntervalUs, odoHysteresisUs);
+    for (i = 0; i < ODO_WHEELS; i++)
+    {
+        odoWheels[i].timing = false;
+        odoWheels[i].periodCount = 0;
+        odoWheels[i].periodIndex = 0;
+    }
+}
+
+// Zero the tick counts of both wheels
+// The first tick after a reset only starts a new period measurement
+void resetOdometry()
+{
+    uint8_t i;
+    WTIMER0_IMR_R &= ~TIMER_IMR_CAEIM;
+    WTIMER1_IMR_R &= ~TIMER_IMR_CAEIM;                  // keep the ISRs out while clearing
+    for (i = 0; i < ODO_WHEELS; i++)
+    {
+        odoWheels[i].ticks = 0;
+        odoWheels[i].rejects = 0;
+        odoWheels[i].timing = false;
+        odoWheels[i].periodCount = 0;
+        odoWheels[i].periodIndex = 0;
+        odoWheels[i].stopFraction = 0;
+    }
+    if (odoMode == ODO_MODE_EDGE_TIME)
+    {
+        WTIMER0_IMR_R |= TIMER_IMR_CAEIM;
+        WTIMER1_IMR_R |= TIMER_IMR_CAEIM;
+    }
+    else
+    {
+        WTIMER0_TAV_R = 0;
+        WTIMER1_TAV_R = 0;
+    }
+}
+
+// Returns the number of magnet ticks seen on a wheel since the last reset
+uint32_t getOdometryTicks(uint8_t wheel)
+{
+    if (odoMode == ODO_MODE_EDGE_COUNT)
+        return wheel == 0 ? WTIMER0_TAV_R : WTIMER1_TAV_R;
+    return odoWheels[wheel].ticks;
+}
+
+// Returns the number of edges rejected by the glitch filter since the last reset
+uint32_t getOdometryRejects(uint8_t wheel)
+{
+    return odoWheels[wheel].rejects;
+}
+
+// Returns the filtered speed of a wheel in mm/s
+// The speed is the moving average of the last ODO_SPEED_WINDOW tick periods; when
+// the wheel slows down between ticks the time since the last tick bounds it, so a
+// stopped wheel reads 0 within ODO_STOP_TIMEOUT_MS instead of holding its last value
+// The periods, their count and the last tick are read with interrupts masked, so an
+// edge cannot mix old and new samples
+uint32_t getWheelSpeed(uint8_t wheel)
+{
+    volatile ODO_WHEEL *w = &odoWheels[wheel];
+    uint32_t sum = 0, count, elapsed, avg, mask;
+    uint8_t i;
+
+    if (odoMode != ODO_MODE_EDGE_TIME)
+        return 0;
+    mask = disableInterrupts();
+    count = w->periodCount;
+    elapsed = (wheel == 0 ? WTIMER0_TAV_R : WTIMER1_TAV_R) - w->lastTick;
+    for (i = 0; i < count; i++)
+        sum += w->period[i];
+    restoreInterrupts(mask);
+    if (count == 0 || elapsed > STOP_TIMEOUT)
+        return 0;
+    avg = sum / count;
+    if (elapsed > avg)
+        avg = elapsed;
+    return SPEED_SCALE / avg;
+}
+
+// Returns the position of a wheel in ticks since the last reset, unsigned Q8
+// Between ticks the fraction is the time since the last tick over the last tick
+// period, held just below the next tick, and stays there once the wheel stopped;
+// edge-count mode has no fraction. The tick state is read with interrupts masked.
+uint32_t getOdometryPosition(uint8_t wheel)
+{
+    volatile ODO_WHEEL *w = &odoWheels[wheel];
+    uint32_t ticks, elapsed, period, fraction, count, mask;
+
+    if (odoMode == ODO_MODE_EDGE_COUNT)
+        return getOdometryTicks(wheel) << 8;
+    mask = disableInterrupts();
+    ticks = w->ticks;
+    fraction = w->stopFraction;
+    count = w->periodCount;
+    elapsed = (wheel == 0 ? WTIMER0_TAV_R : WTIMER1_TAV_R) - w->lastTick;
+    period = w->period[(w->periodIndex + ODO_SPEED_WINDOW - 1) % ODO_SPEED_WINDOW];
+    restoreInterrupts(mask);
+    if (count != 0)
+    {
+        if (elapsed >= period)
+            fraction = 255;
+        else
+            fraction = ((uint64_t)elapsed << 8) / period;
+    }
+    return (ticks << 8) + fraction;
+}
+
+// Returns the period between the last two accepted ticks of a wheel in microseconds
+uint32_t getWheelPeriod(uint8_t wheel)
+{
+    volatile ODO_WHEEL *w = &odoWheels[wheel];
+    if (w->periodCount == 0)
+        return 0;
+    return w->period[(w->periodIndex + ODO_SPEED_WINDOW - 1) % ODO_SPEED_WINDOW] / COUNTS_PER_US;
+}
+
+// Record the period ending with an accepted tick
+void odometryPeriod(volatile ODO_WHEEL *w, uint32_t period)
+{
+    if (period > STOP_TIMEOUT)
+    {
+        // first tick after a stop only starts a new measurement
+        w->periodCount = 0;
+        w->periodIndex = 0;
+        return;
+    }
+    w->period[w->periodIndex] = period;
+    w->periodIndex = (w->periodIndex + 1) % ODO_SPEED_WINDOW;
+    if (w->periodCount < ODO_SPEED_WINDOW)
+        w->periodCount++;
+}
+
+// Glitch filter shared by both capture ISRs
+// A rising edge is a tick only if the output was low for at least the hysteresis
+// time and the previous tick is at least the minimum interval old, so a parked
+// magnet chattering on the sensor threshold cannot add ticks
+void odometryEdge(volatile ODO_WHEEL *w, uint32_t time, bool level)
+{
+    if (!level)
+    {
+        w->low = true;
+        w->lowStart = time;
+    }
+    else
+    {
+        if (w->low && time - w->lowStart >= odoHysteresis && (!w->timing || time - w->lastTick >= odoMinInterval))
+        {
+            w->ticks++;
+            if (w->timing)
+                odometryPeriod(w, time - w->lastTick);
+            w->lastTick = time;
+            w->timing = true;
+            w->stopFraction = 0;
+        }
+        else
+            w->rejects++;
+        w->low = false;
+    }
+}
+
+void wideTimer0Isr()
+{
+    WTIMER0_ICR_R = TIMER_ICR_CAECINT;
+    odometryEdge(&odoWheels[0], WTIMER0_TAR_R, GPIO_PORTC_DATA_R & FREQ_IN_MASK_C4);
+}
+
+void wideTimer1Isr()
+{
+    WTIMER1_ICR_R = TIMER_ICR_CAECINT;
+    odometryEdge(&odoWheels[1], WTIMER1_TAR_R, GPIO_PORTC_DATA_R & FREQ_IN_MASK_C6);
+}
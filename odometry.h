@@ -0,0 +1,60 @@
+// Odometry Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Hall sensor 0:
+//   WT0CCP0 (PC4) senses the magnet on wheel 0
+// Hall sensor 1:
+//   WT1CCP0 (PC6) senses the magnet on wheel 1
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef ODOMETRY_H_
+#define ODOMETRY_H_
+
+#define ODO_WHEELS 2
+
+// Input modes
+#define ODO_MODE_EDGE_COUNT 0   // hardware counts every rising edge (no filtering)
+#define ODO_MODE_EDGE_TIME  1   // every edge is timestamped and filtered in the ISR
+
+// Default glitch filter, in microseconds
+// The fastest real tick period at full duty is well over 5 ms
+#define ODO_DEFAULT_MIN_INTERVAL_US 2000
+#define ODO_DEFAULT_HYSTERESIS_US   500
+
+// Wheel travel per magnet tick (40 ticks measured over 30 cm)
+#define ODO_UM_PER_TICK 7500
+
+// Speed estimator
+#define ODO_SPEED_WINDOW     4      // tick periods in the moving average
+#define ODO_STOP_TIMEOUT_MS  500    // no tick for this long reads as stopped
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initOdometry(void);
+void setOdometryMode(uint8_t mode);
+void setOdometryFilter(uint32_t minIntervalUs, uint32_t hysteresisUs);
+void updateOdometryClock(void);
+void resetOdometry(void);
+uint32_t getOdometryTicks(uint8_t wheel);
+uint32_t getOdometryPosition(uint8_t wheel);
+uint32_t getOdometryRejects(uint8_t wheel);
+uint32_t getWheelSpeed(uint8_t wheel);
+uint32_t getWheelPeriod(uint8_t wheel);
+void wideTimer0Isr(void);
+void wideTimer1Isr(void);
+
+#endif
@@ -0,0 +1,192 @@
+// Power Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz running, 16 MHz idle
+
+// Hardware configuration:
+// Clock:
+//   Idle runs from the 16 MHz crystal with the PLL powered down, running from the PLL
+// DWT:
+//   The cycle counter times every clock switch
+// WTIMER2:
+//   The microsecond counter of the supervisor times every sleep
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "clock.h"
+#include "kernel.h"
+#include "motion.h"
+#include "odometry.h"
+#include "pwm.h"
+#include "supervisor.h"
+#include "timer.h"
+#include "uart0.h"
+#include "ultrasonic.h"
+#include "power.h"
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+uint8_t powerMode = POWER_RUN;
+bool powerScaling = true;
+uint32_t powerModeStart;            // time the current mode was entered, ms
+POWER_STATS powerStats;
+uint32_t sleepUs[POWER_MODES];      // sleep not yet added to the statistics, under 1 ms
+bool deepSleep = false;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Start in the run mode set up by initSystemClockTo80Mhz()
+// Call after initTimer()
+void initPower()
+{
+    uint8_t i;
+    for (i = 0; i < POWER_MODES; i++)
+    {
+        powerStats.switches[i] = 0;
+        powerStats.lastUs[i] = 0;
+        powerStats.maxUs[i] = 0;
+        powerStats.timeMs[i] = 0;
+        powerStats.sleepMs[i] = 0;
+        sleepUs[i] = 0;
+    }
+    powerMode = POWER_RUN;
+    powerModeStart = getTimeMs();
+}
+
+// Reprogram every divider that was computed from the system clock
+void updateClockDividers()
+{
+    setUart0BaudRate(UART0_BAUD_RATE, getSystemClock());
+    updatePwmClock();
+    updateTimerClock();
+    updateSupervisorClock();
+    updateMotionClock();
+    updateOdometryClock();
+    updateUltrasonicClock();
+}
+
+// Switch the system clock and reprogram the dividers that depend on it
+// Only one thread may switch modes. The PLL locks with interrupts enabled while the
+// core still runs from the crystal; only the switch itself and the divider updates are
+// masked, so no interrupt sees a divider for the wrong clock. The latency counts the
+// lock wait in crystal cycles and the masked part in cycles of the new clock.
+void setPowerMode(uint8_t mode)
+{
+    uint32_t start, locked, end, mask, us, now;
+
+    if (mode >= POWER_MODES || mode == powerMode)
+        return;
+    drainUart0();                               // a character in flight would be garbled
+
+    start = DWT_CYCCNT_R;
+    if (mode == POWER_RUN)
+        startPll();
+    locked = DWT_CYCCNT_R;
+    mask = disableInterrupts();
+    if (mode == POWER_RUN)
+        usePllClock();
+    else
+        useCrystalClock();
+    updateClockDividers();
+    restoreInterrupts(mask);
+    end = DWT_CYCCNT_R;
+
+    us = (locked - start) / (F_IDLE / 1000000) + (end - locked) / (getSystemClock() / 1000000);
+    powerStats.switches[mode]++;
+    powerStats.lastUs[mode] = us;
+    if (us > powerStats.maxUs[mode])
+        powerStats.maxUs[mode] = us;
+    now = getTimeMs();
+    powerStats.timeMs[powerMode] += now - powerModeStart;
+    powerModeStart = now;
+    powerMode = mode;
+}
+
+uint8_t getPowerMode()
+{
+    return powerMode;
+}
+
+// Run at full speed while active and drop to the idle clock otherwise
+// Called periodically by the thread that owns the mode
+void updatePowerMode(bool active)
+{
+    setPowerMode(active || !powerScaling ? POWER_RUN : POWER_IDLE);
+}
+
+// Enable or disable the idle clock; with scaling off the next update stays in run
+void setPowerScaling(bool on)
+{
+    powerScaling = on;
+}
+
+bool isPowerScaling()
+{
+    return powerScaling;
+}
+
+// Copy the statistics, the residency includes the time in the current mode so far
+void getPowerStats(POWER_STATS* stats)
+{
+    *stats = powerStats;
+    stats->timeMs[powerMode] += getTimeMs() - powerModeStart;
+}
+
+// Use deep sleep instead of sleep while idle
+// The deep-sleep clock is the undivided crystal, the same as the idle clock, so SysTick,
+// the timers and the UART keep their rate. The motion timer, the odometry timers and the
+// PWM module are gated off in deep sleep since nothing moves while idle; wheel ticks
+// made by hand while asleep are not counted. Call after every peripheral is initialized.
+void setDeepSleep(bool on)
+{
+    SYSCTL_DSLPCLKCFG_R = SYSCTL_DSLPCLKCFG_O_IGN;     // MOSC, divided by 1
+    SYSCTL_DCGCGPIO_R = SYSCTL_RCGCGPIO_R;
+    SYSCTL_DCGCUART_R = SYSCTL_RCGCUART_R;
+    SYSCTL_DCGCADC_R = SYSCTL_RCGCADC_R;
+    SYSCTL_DCGCWD_R = SYSCTL_RCGCWD_R;
+    SYSCTL_DCGCTIMER_R = SYSCTL_RCGCTIMER_R & ~SYSCTL_RCGCTIMER_R2;
+    SYSCTL_DCGCWTIMER_R = SYSCTL_RCGCWTIMER_R & ~(SYSCTL_RCGCWTIMER_R1 | SYSCTL_RCGCWTIMER_R0);
+    SYSCTL_DCGCPWM_R = 0;
+    deepSleep = on;
+}
+
+bool isDeepSleep()
+{
+    return deepSleep;
+}
+
+// Sleep until the next interrupt and add the time asleep to the current mode
+// Interrupts are masked around WFI, so the interrupt that wakes the core only runs once
+// the end of the sleep has been timed. Deep sleep is only used in the idle mode, since
+// the deep-sleep clock would replace the PLL.
+void sleepCpu()
+{
+    uint32_t mask, start;
+
+    mask = disableInterrupts();
+    if (deepSleep && powerMode == POWER_IDLE)
+        NVIC_SYS_CTRL_R |= NVIC_SYS_CTRL_SLEEPDEEP;
+    else
+        NVIC_SYS_CTRL_R &= ~NVIC_SYS_CTRL_SLEEPDEEP;
+    start = getTimeUs();
+    __asm(" WFI");
+    sleepUs[powerMode] += getTimeUs() - start;
+    powerStats.sleepMs[powerMode] += sleepUs[powerMode] / 1000;
+    sleepUs[powerMode] %= 1000;
+    restoreInterrupts(mask);
+}
@@ -0,0 +1,57 @@
+// Power Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz running, 16 MHz idle
+
+// Hardware configuration:
+// Clock:
+//   Idle runs from the 16 MHz crystal with the PLL powered down, running from the PLL
+// DWT:
+//   The cycle counter times every clock switch
+// WTIMER2:
+//   The microsecond counter of the supervisor times every sleep
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef POWER_H_
+#define POWER_H_
+
+// Power modes
+#define POWER_IDLE 0        // F_IDLE, nothing is moving
+#define POWER_RUN  1        // F_CPU, a program is running
+#define POWER_MODES 2
+
+// Switch counts, latencies and residency of each mode
+typedef struct _POWER_STATS
+{
+    uint32_t switches[POWER_MODES];     // switches into the mode
+    uint32_t lastUs[POWER_MODES];       // latency of the last switch into the mode
+    uint32_t maxUs[POWER_MODES];
+    uint32_t timeMs[POWER_MODES];       // time spent in the mode
+    uint32_t sleepMs[POWER_MODES];      // part of it the core was asleep
+} POWER_STATS;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initPower(void);
+void setPowerMode(uint8_t mode);
+uint8_t getPowerMode(void);
+void updatePowerMode(bool active);
+void setPowerScaling(bool on);
+bool isPowerScaling(void);
+void getPowerStats(POWER_STATS* stats);
+void setDeepSleep(bool on);
+bool isDeepSleep(void);
+void sleepCpu(void);
+
+#endif
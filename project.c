@@ -8,7 +8,7 @@
 
 // Target Platform: EK-TM4C123GXL Evaluation Board
 // Target uC:       TM4C123GH6PM
-// System Clock:    40 MHz
+// System Clock:    80 MHz
 
 // Hardware configuration:
 // Red LED:
@@ -33,22 +33,31 @@
 #include "tm4c123gh6pm.h"
 #include "pwm.h"
 #include "wait.h"
+#include "odometry.h"
+#include "motion.h"
+#include "supervisor.h"
+#include "timer.h"
+#include "kernel.h"
+#include "bench.h"
+#include "power.h"
+#include "driver.h"
+#include "events.h"
+#include "trace.h"
+#include "temperature.h"
+#include "battery.h"
+#include "ultrasonic.h"
+#include "scan.h"
+#include "map.h"
 
 // Bitbanding Aliases
 #define RED_LED      (*((volatile uint32_t *)(0x42000000 + (0x400253FC-0x40000000)*32 + 1*4))) // PF1
 #define GREEN_LED    (*((volatile uint32_t *)(0x42000000 + (0x400253FC-0x40000000)*32 + 3*4))) // PF3
 #define BLUE_LED     (*((volatile uint32_t *)(0x42000000 + (0x400253FC-0x40000000)*32 + 2*4))) // PF2
-#define PUSH_BUTTON (*((volatile uint32_t *)(0x42000000 + (0x400253FC-0x40000000)*32 + 4*4))) // PF4
-#define SLEEP_PIN  (*((volatile uint32_t *)(0x42000000 + (0x400053FC-0x40000000)*32 + 6*4))) // PB6
-
-#define TRIGGER_PIN (*((volatile uint32_t *)(0x42000000 + (0x400243FC-0x40000000)*32 + 1*4))) // PE1
-#define ECHO_PIN    (*((volatile uint32_t *)(0x42000000 + (0x400243FC-0x40000000)*32 + 3*4))) // PE3
 
 // Masks
 #define RED_LED_MASK 2
 #define BLUE_LED_MASK 4
 #define GREEN_LED_MASK 8
-#define PUSH_BUTTON_MASK 16
 
 #define MAX_CHARS 80
 #define MAX_FIELDS 5
@@ -56,15 +65,8 @@
 // PortB masks
 #define RED_BL_LED_MASK 32 // B5
 #define NEW_BL_MASK 16 // B4
-#define SLEEP_MASK 64
-
-// PortC masks
-#define FREQ_IN_MASK_C6 64
-#define FREQ_IN_MASK_C4 16
 
 // PortE masks
-#define TRIGGER_MASK 2
-#define ECHO_MASK 8
 #define BLUE_BL_LED_MASK 16
 #define GREEN_BL_LED_MASK 32
 
@@ -81,6 +83,49 @@ char fieldType[MAX_FIELDS];
 
 #define MAX_INSTRUCTIONS 10
 
+// Roll-out after a stop is over once no tick is seen for STOP_SETTLE_MS
+#define STOP_SETTLE_MS     150
+#define STOP_SETTLE_MAX_MS 1000
+
+// Pause units, kept in the subcommand
+#define PAUSE_MS  0
+#define PAUSE_S   1
+#define PAUSE_MIN 2
+#define PAUSE_H   3
+
+// Scan, only queued by the scan command itself
+#define CMD_SCAN 7
+
+// Instruction executor phases
+#define EXEC_IDLE   0
+#define EXEC_STEP   1       // start the next step
+#define EXEC_RAMP   2       // ramping a running move down before the step
+#define EXEC_SETTLE 3       // waiting for the wheels to roll out after a stop
+#define EXEC_ACTION 4       // start the step itself
+#define EXEC_WAIT   5       // waiting for the step to finish
+#define EXEC_DONE   6       // the step finished
+#define EXEC_WAKE   7       // waiting for the motor driver to settle before a move
+
+// Thread priorities (0 is the highest), periods and stacks
+#define CONTROL_PRIORITY      0
+#define RANGING_PRIORITY      1
+#define CONSOLE_PRIORITY      2
+#define TELEMETRY_PRIORITY    3
+#define IDLE_PRIORITY         7
+#define EXECUTOR_PERIOD_MS    5     // poll period of moves, other steps wait for an event
+#define CONTROL_STACK_BYTES   1536
+#define RANGING_STACK_BYTES   512
+#define CONSOLE_STACK_BYTES   1536
+#define TELEMETRY_STACK_BYTES 1024
+#define IDLE_STACK_BYTES      256
+
+// Messages to the control thread
+#define CONTROL_NONE  0
+#define CONTROL_ABORT 1
+#define CONTROL_START 2     // a program was loaded
+#define CONTROL_EVENT 3     // range reading or pause timer
+#define CONTROL_BUTTON 4    // SW1 pressed: start the queue, or go on with the next step
+
 typedef struct _instruction
 {
 uint8_t command;
@@ -92,98 +137,91 @@ uint16_t argument;
 // Subroutines
 //-----------------------------------------------------------------------------
 
-void configTimers()
-{
-	WTIMER0_CTL_R &= ~TIMER_CTL_TAEN;
-	WTIMER1_CTL_R &= ~TIMER_CTL_TAEN;	// turn-off counter before reconfiguring
-    WTIMER0_CFG_R = 4;    
-	WTIMER1_CFG_R = 4;	// configure as 32-bit counter (A only)
-    WTIMER0_TAMR_R = TIMER_TAMR_TAMR_CAP | TIMER_TAMR_TACDIR;  // configure for count up, capture
-	WTIMER1_TAMR_R = TIMER_TAMR_TAMR_CAP | TIMER_TAMR_TACDIR; // configure for count up, capture
-    WTIMER0_TAMR_R &= ~TIMER_TAMR_TACMR;
-	WTIMER1_TAMR_R &= ~TIMER_TAMR_TACMR;	// configure edge-count
-    WTIMER0_IMR_R = 0;
-	WTIMER1_IMR_R = 0;	// turn-off interrupts
-    WTIMER0_TAV_R = 0;
-	WTIMER1_TAV_R = 0;	// zero counter for first period
-    WTIMER0_CTL_R |= TIMER_CTL_TAEN;
-	WTIMER1_CTL_R |= TIMER_CTL_TAEN;
-}
-
 // Initialize Hardware
 void initHw()
 {
-    // Initialize system clock to 40 MHz
-    initSystemClockTo40Mhz();
+    // Initialize system clock to 80 MHz
+    initSystemClockTo80Mhz();
+
+    // Cycle counter for the waits and the kernel statistics
+    initCycleCounter();
 
 
     // Enable clocks
     SYSCTL_RCGCGPIO_R |= SYSCTL_RCGCGPIO_R1 | SYSCTL_RCGCGPIO_R2 | SYSCTL_RCGCGPIO_R4 | SYSCTL_RCGCGPIO_R5;
     SYSCTL_RCGCPWM_R |= SYSCTL_RCGCPWM_R0;
-    SYSCTL_RCGCWTIMER_R |= SYSCTL_RCGCWTIMER_R1 | SYSCTL_RCGCWTIMER_R0;
-	SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R1;
-	_delay_cycles(3);
-	
-	TIMER1_CTL_R &= ~TIMER_CTL_TAEN;
-	TIMER1_CFG_R = 0;
-	TIMER1_TAMR_R = 0x2;
-	TIMER1_TAMR_R |= TIMER_TAMR_TACDIR;
-	TIMER1_TAV_R = 0;
-	
-	
     _delay_cycles(3);
 
-    initPWM();
+    initPWM(PWM_DEFAULT_FREQUENCY_HZ);
 
     // PF1-4 for LEDs and Push Button
     GPIO_PORTF_DIR_R |= BLUE_LED_MASK | RED_LED_MASK | GREEN_LED_MASK;
-    GPIO_PORTF_DIR_R &= ~PUSH_BUTTON_MASK;
-    GPIO_PORTF_PUR_R |= PUSH_BUTTON_MASK;
     GPIO_PORTF_DR2R_R |= BLUE_LED_MASK | RED_LED_MASK | GREEN_LED_MASK;
-    GPIO_PORTF_DEN_R |= BLUE_LED_MASK | RED_LED_MASK | GREEN_LED_MASK | PUSH_BUTTON_MASK;
+    GPIO_PORTF_DEN_R |= BLUE_LED_MASK | RED_LED_MASK | GREEN_LED_MASK;
 
+    // Millisecond clock and software timers, before anything that may start a timer
+    initTimer();
+
+    // SW1 and SW2 edge interrupts with debouncing
+    initEvents();
+
+    // Clock scaling between the idle and run modes
+    initPower();
 
     // PC4 and PC6 for WTIMERS for detecting magnet rotations.
-    GPIO_PORTC_AFSEL_R |= FREQ_IN_MASK_C6 | FREQ_IN_MASK_C4;
-    GPIO_PORTC_PCTL_R &= ~(GPIO_PCTL_PC6_M | GPIO_PCTL_PC4_M);
-    GPIO_PORTC_PCTL_R |= GPIO_PCTL_PC6_WT1CCP0 | GPIO_PCTL_PC4_WT0CCP0;
-    GPIO_PORTC_PUR_R |= FREQ_IN_MASK_C6 | FREQ_IN_MASK_C4;
-    GPIO_PORTC_DEN_R |= FREQ_IN_MASK_C6 | FREQ_IN_MASK_C4;
-	
-	configTimers();
-	
-	GPIO_PORTE_DIR_R |= TRIGGER_MASK;
-	GPIO_PORTE_DIR_R &= ~ECHO_MASK;
-	GPIO_PORTE_DR2R_R |= TRIGGER_MASK | ECHO_MASK;
-	GPIO_PORTE_DEN_R |= TRIGGER_MASK | ECHO_MASK;
-
-}
-
-// Function that gets string from terminal
-// Supports backspaces and enter keys
-void getsUart0(USER_DATA* data)
-{
-    int count = 0;
+    initOdometry();
+
+    // Microsecond time base and watchdog
+    initSupervisor();
+
+    // Motion profile timer
+    initMotion();
+
+    // Motor driver asleep until the first move
+    initDriver();
+
+    // Internal temperature sensor for the speed of sound
+    initTemperature();
+
+    // Battery voltage on PE2 for the duty compensation
+    initBattery();
+
+    // Ultrasonic sensors on ports A, D and E
+    initUltrasonic();
+}
+
+uint8_t lineCount = 0;          // characters of the line being typed
+
+// Function that gets string from terminal without waiting
+// Takes the characters that have arrived and supports backspaces and enter keys
+// Returns true once the line is complete
+bool getsUart0(USER_DATA* data)
+{
     char c;
 
-    while(1)
+    while(kbhitUart0())
     {
         c = getcUart0();
 
         // If char c is a backspace (8 or 127), allows overriding of buffer
-        if( c == 8 || c == 127 && count > 0)
-            count--;
+        if( c == 8 || c == 127 )
+        {
+            if(lineCount > 0)
+                lineCount--;
+        }
         // If the char c is readable (space, num, alpha), read to buffer
         else if( c >= 32 )
-            data->buffer[count++] = c;
+            data->buffer[lineCount++] = c;
 
         // If return is hit or the MAX_CHARS limit reached, add the null and return
-        if( c == 13 || count == MAX_CHARS)
+        if( c == 13 || lineCount == MAX_CHARS)
         {
-            data->buffer[count] = '\0';
-            return;
+            data->buffer[lineCount] = '\0';
+            lineCount = 0;
+            return true;
         }
     }
+    return false;
 }
 
 void parseFields(USER_DATA* data)
@@ -291,6 +329,37 @@ bool strcomp(char * a, char * b)
 }
 
 
+// Returns the stop mode named after a motion command, STOP_DEFAULT if there is none
+uint8_t getStopModeField(USER_DATA* data)
+{
+    uint8_t i;
+    for(i = 1; i < data->fieldCount; i++)
+    {
+        if( strcomp(getFieldString(data, i), "brake") )
+            return STOP_BRAKE;
+        if( strcomp(getFieldString(data, i), "coast") )
+            return STOP_COAST;
+    }
+    return STOP_DEFAULT;
+}
+
+// Returns the unit named after a pause count, milliseconds if none
+uint8_t getPauseUnitField(USER_DATA* data)
+{
+    char* unit;
+    if(data->fieldCount < 3)
+        return PAUSE_MS;
+    unit = getFieldString(data, 2);
+    if( strcomp(unit, "s") )
+        return PAUSE_S;
+    if( strcomp(unit, "min") )
+        return PAUSE_MIN;
+    if( strcomp(unit, "h") )
+        return PAUSE_H;
+    return PAUSE_MS;
+}
+
+
 bool isCommand(USER_DATA* data, char strCommand[], uint8_t minArguments)
 {
     char* strCompare = &data->buffer[ data->fieldPosition[0] ];
@@ -301,187 +370,490 @@ bool isCommand(USER_DATA* data, char strCommand[], uint8_t minArguments)
         return false;
 }
 
-void rb_forward( int16_t dist )
+typedef struct _MOVE_SUPERVISOR
 {
-    uint16_t ticks = 40 * dist / 30;
+    bool timed;                         // false for moves without a distance
+    uint32_t deadline;
+    uint32_t nextCheck;
+    uint32_t lastTicks[ODO_WHEELS];
+} MOVE_SUPERVISOR;
 
-	// Calculate distance in centimeters.
-    PWM0_1_CMPA_R = 0;
-    PWM0_1_CMPB_R = 1001;
-    PWM0_2_CMPA_R = 996;
-    PWM0_2_CMPB_R = 0;
-    GREEN_LED = 1;
+MOVE_SUPERVISOR rb_motion;
 
-    if(dist == -1)
+// Stopping distance statistics of the current run, coast and brake
+typedef struct _STOP_STATS
+{
+    uint8_t count;
+    uint32_t sum;
+    uint32_t min;
+    uint32_t max;
+} STOP_STATS;
+
+STOP_STATS rb_stops[2];
+
+// Program being run by the executor task
+typedef struct _EXECUTOR
+{
+    instruction program[MAX_INSTRUCTIONS];
+    uint8_t count;
+    int8_t loop;                        // step to go on with after the last, -1 to end
+    uint8_t step;                       // instruction being executed
+    uint8_t phase;                      // EXEC_xxx
+    uint8_t next;                       // phase after the roll-out
+    uint8_t code;
+    uint32_t start;                     // ms the step started
+    uint32_t ticks;                     // length of the move being waited on
+    uint32_t deadline;                  // ramp, roll-out or pause unit deadline
+    uint32_t quiet;                     // roll-out: end of the time without ticks
+    uint32_t settleTicks;               // roll-out: tick sum of both wheels
+    uint16_t remaining;                 // pause: units after the current one
+    uint32_t unitMs;                    // pause: length of a unit
+    uint32_t cruise;                    // scan: cruise speed to restore, 0 if not scanning
+    bool eventWait;                     // the step only waits for a message
+} EXECUTOR;
+
+EXECUTOR rb_exec;
+
+instruction inst_arr[MAX_INSTRUCTIONS];     // the queue edited by the console
+int8_t inst_index = 0;
+bool inst_max = false;
+
+SEMAPHORE executorLock;             // held while the program is started or advanced
+SEMAPHORE rangeReady;               // posted by the ranging interrupt for every new result
+SEMAPHORE consoleReady;             // posted by the UART interrupt when characters arrive
+SEMAPHORE telemetryWake;            // posted when the telemetry period is set
+QUEUE controlQueue;                 // CONTROL_xxx messages to the control thread
+uint32_t telemetryMs = 0;           // telemetry period, 0 for none
+volatile bool mapClearing = false;     // mapclear typed, done by the ranging thread
+volatile bool batteryChanged = false;   // the low-battery warning changed, not yet printed
+
+// Arm the deadline and progress checks for a move of the given number of ticks
+// A move of 0 ticks runs until another instruction stops it and has no deadline
+void rb_startSupervision( uint32_t ticks )
+{
+    uint8_t i;
+    rb_motion.timed = ticks != 0;
+    rb_motion.deadline = makeDeadline(MOVE_BASE_TIMEOUT_MS + ticks * MOVE_TICK_TIMEOUT_MS);
+    rb_motion.nextCheck = makeDeadline(STALL_GRACE_MS);
+    for(i = 0; i < ODO_WHEELS; i++)
+        rb_motion.lastTicks[i] = 0;
+}
+
+// Called on every poll of a step that waits on a move
+// A wheel that has ticks to go and neither ticked nor reads a speed over a whole
+// check interval is stalled
+uint8_t rb_supervise( uint32_t ticks )
+{
+    uint32_t t;
+    uint8_t i;
+
+    if(rb_motion.timed && deadlinePassed(rb_motion.deadline))
+        return ERR_TIMEOUT;
+    if(deadlinePassed(rb_motion.nextCheck))
     {
-        return;
+        for(i = 0; i < ODO_WHEELS; i++)
+        {
+            t = getOdometryTicks(i);
+            if((ticks == 0 || t < ticks) && t == rb_motion.lastTicks[i] && getWheelSpeed(i) == 0)
+                return ERR_STALL;
+            rb_motion.lastTicks[i] = t;
+        }
+        rb_motion.nextCheck = makeDeadline(STALL_INTERVAL_MS);
     }
-    else
+    return ERR_NONE;
+}
+
+// Motors off after an error
+uint8_t rb_fail( uint8_t code )
+{
+    failSafe();
+    GREEN_LED = 0;
+    return code;
+}
+
+// Wait for the wheels to roll out after a stop, then go on with the given phase
+void rb_startSettle( uint8_t next )
+{
+    rb_exec.deadline = makeDeadline(STOP_SETTLE_MAX_MS);
+    rb_exec.quiet = makeDeadline(STOP_SETTLE_MS);
+    rb_exec.settleTicks = getOdometryTicks(0) + getOdometryTicks(1);
+    rb_exec.next = next;
+    rb_exec.phase = EXEC_SETTLE;
+}
+
+// Once the wheels have rolled out, record the stopping distance in the trace and
+// in the statistics of its stop mode
+void rb_settle()
+{
+    STOP_STATS * stats;
+    uint32_t ticks = getOdometryTicks(0) + getOdometryTicks(1);
+    uint32_t dist;
+    uint8_t mode;
+
+    if(ticks != rb_exec.settleTicks)
     {
-        WTIMER0_TAV_R = 0;
-        WTIMER1_TAV_R = 0;
-        while(WTIMER0_TAV_R < ticks || WTIMER1_TAV_R < ticks);
-        GREEN_LED = 0;
-        PWM0_1_CMPB_R = 0;
-        PWM0_2_CMPA_R = 0;
+        rb_exec.settleTicks = ticks;
+        rb_exec.quiet = makeDeadline(STOP_SETTLE_MS);
     }
+    if(!deadlinePassed(rb_exec.quiet) && !deadlinePassed(rb_exec.deadline))
+        return;
 
+    dist = getStopDistance();
+    mode = getLastStopMode();
+    traceEvent(rb_exec.step, mode == STOP_BRAKE ? TRACE_BRAKE : TRACE_COAST, ERR_NONE, dist);
+
+    stats = &rb_stops[mode == STOP_BRAKE];
+    if(stats->count == 0 || dist < stats->min)
+        stats->min = dist;
+    if(stats->count == 0 || dist > stats->max)
+        stats->max = dist;
+    stats->sum += dist;
+    stats->count++;
+    rb_exec.phase = rb_exec.next;
+    return;
+}
 
-    //waitMicrosecond(1000000);
-
+// Ramp a move that is still running down before the step, or start the step
+void rb_rampDown( uint8_t mode )
+{
+    if(!isMoving())
+    {
+        rb_exec.phase = EXEC_ACTION;
+        return;
+    }
+    stopMove(mode);
+    rb_exec.deadline = makeDeadline(MOVE_BASE_TIMEOUT_MS);
+    rb_exec.phase = EXEC_RAMP;
+}
 
-	return;
+// Start a profiled move of the given number of ticks
+// A move of 0 ticks is left running and ends the step at once
+void rb_move( int8_t leftDir, int8_t rightDir, uint32_t ticks, uint8_t mode )
+{
+    startMove(leftDir, rightDir, ticks, mode);
+    rb_startSupervision(ticks);
+    rb_exec.ticks = ticks;
+    rb_exec.phase = ticks == 0 ? EXEC_DONE : EXEC_WAIT;
 }
 
-void rb_reverse( int16_t dist )
+void rb_forward( int16_t dist, uint8_t mode )
 {
     uint16_t ticks = 40 * dist / 30;
 
 	// Calculate distance in centimeters.
-    PWM0_1_CMPA_R = 1001;
-    PWM0_1_CMPB_R = 0;
-    PWM0_2_CMPA_R = 0;
-    PWM0_2_CMPB_R = 996;
     GREEN_LED = 1;
 
-    //waitMicrosecond(1000000);
-
     if(dist == -1)
-    {
-        return;
-    }
+        rb_move(1, 1, 0, mode);
+    else if(ticks == 0)
+        rb_exec.phase = EXEC_DONE;
     else
-    {
-        WTIMER0_TAV_R = 0;
-        WTIMER1_TAV_R = 0;
-        while(WTIMER0_TAV_R < ticks || WTIMER1_TAV_R < ticks);
-        GREEN_LED = 0;
-        PWM0_1_CMPA_R = 0;
-        PWM0_2_CMPB_R = 0;
-    }
-    return;
+        rb_move(1, 1, ticks, mode);
 }
 
-void rb_cwRotate( int16_t angle )
+void rb_reverse( int16_t dist, uint8_t mode )
 {
-    uint16_t ticks = 20 * angle / 90;
-
-    PWM0_1_CMPA_R = 1001;
-    PWM0_1_CMPB_R = 0;
-    PWM0_2_CMPA_R = 996;
-    PWM0_2_CMPB_R = 0;
+    uint16_t ticks = 40 * dist / 30;
 
-    //waitMicrosecond(1000000);
-    WTIMER0_TAV_R = 0;
-    WTIMER1_TAV_R = 0;
-    while(WTIMER0_TAV_R < ticks || WTIMER1_TAV_R < ticks);
+	// Calculate distance in centimeters.
+    GREEN_LED = 1;
 
-    PWM0_1_CMPA_R = 0;
-    PWM0_2_CMPA_R = 0;
-	return;
+    if(dist == -1)
+        rb_move(-1, -1, 0, mode);
+    else if(ticks == 0)
+        rb_exec.phase = EXEC_DONE;
+    else
+        rb_move(-1, -1, ticks, mode);
 }
 
-void rb_ccwRotate( int16_t angle )
+void rb_cwRotate( int16_t angle, uint8_t mode )
 {
-    uint16_t ticks = 45 * angle / 180;
+    uint16_t ticks = 20 * angle / 90;
 
-    PWM0_1_CMPA_R = 0;
-    PWM0_1_CMPB_R = 1001;
-    PWM0_2_CMPA_R = 0;
-    PWM0_2_CMPB_R = 996;
+    if(ticks == 0)
+        rb_exec.phase = EXEC_DONE;
+    else
+        rb_move(1, -1, ticks, mode);
+}
 
-    //waitMicrosecond(1000000);
-    WTIMER0_TAV_R = 0;
-    WTIMER1_TAV_R = 0;
-    while(WTIMER0_TAV_R < ticks || WTIMER1_TAV_R < ticks);
+void rb_ccwRotate( int16_t angle, uint8_t mode )
+{
+    uint16_t ticks = 45 * angle / 180;
 
-    PWM0_1_CMPB_R = 0;
-    PWM0_2_CMPB_R = 0;
-	return;
+    if(ticks == 0)
+        rb_exec.phase = EXEC_DONE;
+    else
+        rb_move(-1, 1, ticks, mode);
 }	
 
-void wait_distance( uint32_t input )
+// Rotates once cw in place at the scan speed; the polar array is filled from the
+// front distance while the executor polls the rotation
+void rb_scan()
 {
-    uint32_t dist;
-    //char s[5];
-
-    RED_LED = 1;
-    ECHO_PIN = 0;
+    rb_exec.cruise = getMotionCruise();
+    setMotionSpeed(SCAN_SPEED);
+    rb_move(1, -1, SCAN_TICKS_PER_REV, STOP_DEFAULT);
+}
 
-    do
-    {
-        TIMER1_TAV_R = 0;
+// Poll of a scan rotation
+uint8_t rb_scanning()
+{
+    char output[40];
+    uint8_t code = rb_supervise(SCAN_TICKS_PER_REV);
+
+    updateScan();
+    if(code != ERR_NONE || isMoving())
+        return code;
+    setMotionSpeed(rb_exec.cruise);
+    rb_exec.cruise = 0;
+    sprintf(output, "scan: %u of %u steps\n", getScanFilled(), getScanCount());
+    putsUart0(output);
+    rb_exec.phase = EXEC_DONE;
+    return ERR_NONE;
+}
 
-        TRIGGER_PIN = 1;
-        waitMicrosecond(20);
-        TRIGGER_PIN = 0;
+// Poll of a move; once it ends the wheels are left to roll out
+uint8_t rb_moving()
+{
+    uint8_t code = rb_supervise(rb_exec.ticks);
 
-        while( !ECHO_PIN );
-        TIMER1_CTL_R |= TIMER_CTL_TAEN;
+    if(code == ERR_NONE && !isMoving())
+    {
+        GREEN_LED = 0;
+        rb_startSettle(EXEC_DONE);
+    }
+    return code;
+}
 
-        while( ECHO_PIN )
-        {
-            if(TIMER1_TAV_R % 100000 == 0)
-            {
-                BLUE_LED = 0;
-                GREEN_LED = 0;
-            }
-            else
-            {
-                BLUE_LED = 1;
-                GREEN_LED = 1;
-            }
-        }
-        TIMER1_CTL_R &= ~TIMER_CTL_TAEN;
-        dist = TIMER1_TAV_R  * 0.025 / 58;
-        //sprintf(s, "%d < %d\n", dist, input);
-        //putsUart0(s);
-        //waitMicrosecond(1000000);
+// Reports a protective stop made by the echo interrupt since the last check
+// Returns ERR_PROTECT once for each stop
+uint8_t rb_protectStop()
+{
+    char output[60];
+    uint32_t dist, latency;
+
+    if(!takeProtectStop(&dist, &latency))
+        return ERR_NONE;
+    traceEvent(rb_exec.step, TRACE_PROTECT, ERR_PROTECT, latency);
+    sprintf(output, "protective stop at %u mm, %u us after the echo\n", dist, latency);
+    putsUart0(output);
+    return ERR_PROTECT;
+}
 
-    } while( dist > input );
+// Done once the filtered distance is closer than input cm
+// A running move keeps its stall checks while we wait. A distance inside the protect
+// zone is never reached by a forward move, since the echo interrupt stops it first;
+// that stop fails the step here instead of leaving the wait with the wheels stopped
+uint8_t wait_distance( uint32_t input )
+{
+    uint8_t code = rb_protectStop();
 
-    BLUE_LED = 1;
-    GREEN_LED = 1;
-    //waitMicrosecond(1000000);
-    RED_LED = 0;
-    GREEN_LED = 0;
-    BLUE_LED = 0;
-    return;
+    if(code != ERR_NONE)
+    {
+        RED_LED = 0;
+        return code;
+    }
+    if(isRangeValid(RANGE_FRONT) && getRangeDistance(RANGE_FRONT) <= input * 10)
+    {
+        RED_LED = 0;
+        rb_exec.phase = EXEC_DONE;
+        return ERR_NONE;
+    }
+    if(isMoving())
+        code = rb_supervise(0);
+    if(code == ERR_NONE && getRangeMisses(RANGE_FRONT) >= ECHO_MAX_MISSES)
+        code = ERR_ECHO;
+    if(code != ERR_NONE)
+        RED_LED = 0;
+    return code;
 }
 
-void rb_wait( uint16_t mode, uint32_t sub )
+void rb_wait( uint16_t mode )
 {
     RED_LED = 1;
+    rb_exec.phase = EXEC_WAIT;
     if(mode == 0x1111)
     {
-        SLEEP_PIN = 0;
-        while(PUSH_BUTTON);
-        SLEEP_PIN = 1;
+        sleepDriver();
+        flushEvents(EVENT_SW1);     // only a press after the step started counts
+    }
+    else if(mode != 0x2222)
+    {
+        RED_LED = 0;
+        rb_exec.phase = EXEC_DONE;
     }
-    else if(mode == 0x2222)
+}
+
+// Poll of a wait; the button wait takes the debounced events of SW1
+uint8_t rb_waiting( uint16_t mode, uint32_t sub )
+{
+    uint8_t event;
+    if(mode == 0x2222)
+        return wait_distance(sub);
+    while(tryEvent(EVENT_SW1, &event))
     {
-        wait_distance(sub);
+        if(event == EVENT_PRESS)
+        {
+            RED_LED = 0;
+            rb_exec.phase = EXEC_DONE;
+            break;
+        }
     }
-    RED_LED = 0;
-	return;
+    return ERR_NONE;
+}
+
+// Waits count units without holding up the other tasks
+// The deadline advances one unit at a time so hours never overflow it
+void rb_pause( uint16_t count, uint8_t unit )
+{
+    rb_exec.unitMs = 1;
+    if(unit == PAUSE_S)
+        rb_exec.unitMs = 1000;
+    else if(unit == PAUSE_MIN)
+        rb_exec.unitMs = 60000;
+    else if(unit == PAUSE_H)
+        rb_exec.unitMs = 3600000;
+    rb_exec.remaining = count;
+    rb_exec.deadline = getTimeMs();
+    rb_exec.phase = EXEC_WAIT;
+}
+
+// Wakes the control thread at the end of a pause unit, called from SysTick
+void rb_pauseEvent()
+{
+    queueSend(&controlQueue, CONTROL_EVENT);
 }
 
-void rb_pause( uint8_t time )
+// Poll of a pause; a one-shot timer wakes the next poll at the unit deadline
+uint8_t rb_pausing()
 {
-    waitMicrosecond(time *  1000);
-	return;
+    while(deadlinePassed(rb_exec.deadline))
+    {
+        if(rb_exec.remaining == 0)
+        {
+            rb_exec.phase = EXEC_DONE;
+            return ERR_NONE;
+        }
+        rb_exec.remaining--;
+        rb_exec.deadline += rb_exec.unitMs;
+    }
+    startOneshotTimer(rb_pauseEvent, rb_exec.deadline - getTimeMs());
+    return ERR_NONE;
 }
 
+// The running move has already been ramped down
 void rb_stop()
 {
-    SLEEP_PIN = 0;
+    sleepDriver();
     RED_LED = 1;
-	return;
+    rb_exec.phase = EXEC_DONE;
+}
+
+// Sets a runtime parameter by name
+void rb_set( char * name, int32_t value )
+{
+    if(value < 0)
+        putsUart0("invalid value\n");
+    else if(strcomp(name, "speed"))
+    {
+        if(!setMotionSpeed(value))
+            putsUart0("speed out of range\n");
+    }
+    else if(strcomp(name, "accel"))
+    {
+        if(!setMotionAccel(value))
+            putsUart0("acceleration out of range\n");
+    }
+    else if(strcomp(name, "decel"))
+    {
+        if(!setMotionDecel(value))
+            putsUart0("deceleration out of range\n");
+    }
+    else if(strcomp(name, "jerk"))
+    {
+        if(!setMotionJerk(value))
+            putsUart0("jerk out of range\n");
+    }
+    else if(strcomp(name, "brake"))
+        setStopMode(value ? STOP_BRAKE : STOP_COAST);
+    else if(strcomp(name, "braketime"))
+        setBrakeTime(value);
+    else if(strcomp(name, "protect"))
+        setProtectZone(value);
+    else if(strcomp(name, "rangerate"))
+    {
+        if(!setRangingRate(value))
+            putsUart0("rate out of range\n");
+    }
+    else if(strcomp(name, "pwmfreq"))
+    {
+        if(!setPwmFrequency(value))
+            putsUart0("frequency out of range\n");
+    }
+    else if(strcomp(name, "batcomp"))
+        setBatteryCompensation(value != 0);
+    else if(strcomp(name, "drvidle"))
+    {
+        if(!setDriverIdleTime(value))
+            putsUart0("idle time out of range\n");
+    }
+    else
+        putsUart0("unknown parameter\n");
+    return;
+}
+
+char* rangeNames[RANGE_SENSORS] = {"front", "left", "right", "rear"};
+char* pauseUnits[4] = {"ms", "s", "min", "h"};
+
+// Prints the motion, ranging and odometry telemetry
+void rb_status()
+{
+    char output[80];
+    uint32_t distances[RANGE_SENSORS];
+    int32_t x, y;
+    uint16_t heading;
+    uint8_t valid;
+    uint8_t i;
+    sprintf(output, "profile: %u mm/s\n", getMotionSpeed());
+    putsUart0(output);
+    sprintf(output, "pwm: %u Hz, %u steps\n", getPwmFrequency(), getPwmResolution());
+    putsUart0(output);
+    sprintf(output, "range: %u slots/s\n", getRangingRate());
+    putsUart0(output);
+    valid = getRangeDistances(distances);
+    for(i = 0; i < RANGE_SENSORS; i++)
+    {
+        sprintf(output, "  %s: %u mm%s\n", rangeNames[i], distances[i], valid & (1 << i) ? "" : " (invalid)");
+        putsUart0(output);
+    }
+    sprintf(output, "battery: %u mV%s, gain %u.%03u%s\n", getBatteryVoltage(), isBatteryLow() ? " (low)" : "",
+            getBatteryGain() >> BATTERY_GAIN_SHIFT, (getBatteryGain() & (BATTERY_GAIN_ONE - 1)) * 1000 / BATTERY_GAIN_ONE,
+            isBatteryCompensation() ? "" : " (off)");
+    putsUart0(output);
+    sprintf(output, "air: %d C, %u mm/s\n", getTemperature() / 10, getSoundSpeed());
+    putsUart0(output);
+    sprintf(output, "protect: %u mm, max latency %u us\n", getProtectZone(), getProtectMaxLatency());
+    putsUart0(output);
+    getPose(&x, &y, &heading);
+    sprintf(output, "pose: %d, %d mm, %u.%u deg\n", x, y, heading / 10, heading % 10);
+    putsUart0(output);
+    for(i = 0; i < ODO_WHEELS; i++)
+    {
+        sprintf(output, "wheel %d: %u ticks, %u rejected, %u mm/s\n", i,
+                getOdometryTicks(i), getOdometryRejects(i), getWheelSpeed(i));
+        putsUart0(output);
+    }
+    sprintf(output, "driver: %s, %u wakes, %u s asleep, idle %u ms\n", isDriverAwake() ? "awake" : "asleep",
+            getDriverWakes(), getDriverAsleepMs() / 1000, getDriverIdleTime());
+    putsUart0(output);
+    sprintf(output, "buttons: SW1 %u, SW2 %u bounces\n", getEventBounces(EVENT_SW1), getEventBounces(EVENT_SW2));
+    putsUart0(output);
+    return;
 }
 
 void comm2str(instruction instruct, int index)
 {
-    char output[20];
+    char output[30];
     int16_t argument = instruct.argument;
     if(argument == 0xFFFF)
         argument = -1;
@@ -518,7 +890,7 @@ void comm2str(instruction instruct, int index)
         putsUart0(output);
         break;
     case 5:
-        sprintf(output, "%d. pause %d", index+1, instruct.argument);
+        sprintf(output, "%d. pause %d %s", index+1, instruct.argument, pauseUnits[instruct.subcommand]);
         putsUart0(output);
         break;
     case 6:
@@ -526,6 +898,13 @@ void comm2str(instruction instruct, int index)
         putsUart0(output);
         break;
     }
+    if(instruct.command != 4 && instruct.command != 5)
+    {
+        if(instruct.subcommand == STOP_BRAKE)
+            putsUart0(" brake");
+        else if(instruct.subcommand == STOP_COAST)
+            putsUart0(" coast");
+    }
     putcUart0('\n');
     return;
 }
@@ -536,6 +915,7 @@ instruction comm2instruct(USER_DATA comm)
     if( isCommand(&comm, "forward", 2) )
     {
         returnStruct.command = 0;
+        returnStruct.subcommand = getStopModeField(&comm);
         if( getFieldInteger(&comm, 1) == -1 )
             returnStruct.argument = 0xFFFF;
         else
@@ -545,6 +925,7 @@ instruction comm2instruct(USER_DATA comm)
     if( isCommand(&comm, "reverse", 2) )
     {
         returnStruct.command = 1;
+        returnStruct.subcommand = getStopModeField(&comm);
         if( getFieldInteger(&comm, 1) == -1 )
             returnStruct.argument = 0xFFFF;
         else
@@ -554,6 +935,7 @@ instruction comm2instruct(USER_DATA comm)
     if( isCommand(&comm, "cw", 2) )
     {
         returnStruct.command = 2;
+        returnStruct.subcommand = getStopModeField(&comm);
         if( getFieldInteger(&comm, 1) == -1 )
             returnStruct.argument = 0xFFFF;
         else
@@ -563,6 +945,7 @@ instruction comm2instruct(USER_DATA comm)
     if( isCommand(&comm, "ccw", 2) )
     {
         returnStruct.command = 3;
+        returnStruct.subcommand = getStopModeField(&comm);
         if( getFieldInteger(&comm, 1) == -1 )
             returnStruct.argument = 0xFFFF;
         else
@@ -581,12 +964,14 @@ instruction comm2instruct(USER_DATA comm)
     if( isCommand(&comm, "pause", 2) )
     {
         returnStruct.command = 5;
+        returnStruct.subcommand = getPauseUnitField(&comm);
         returnStruct.argument = getFieldInteger(&comm, 1);
     }
 
     if( isCommand(&comm, "stop", 1) )
     {
         returnStruct.command = 6;
+        returnStruct.subcommand = getStopModeField(&comm);
         returnStruct.argument = getFieldInteger(&comm, 1);
     }
 
@@ -595,21 +980,25 @@ instruction comm2instruct(USER_DATA comm)
 
 void test()
 {
-    PWM0_1_CMPA_R = 1000;
+    setPwmDuty(1, PWM_DUTY_MAX, 0);
+    commitPwm();
     waitMicrosecond(1000000);
-    PWM0_1_CMPA_R = 0;
 
-    PWM0_1_CMPB_R = 1000;
+    setPwmDuty(1, 0, PWM_DUTY_MAX);
+    commitPwm();
     waitMicrosecond(1000000);
-    PWM0_1_CMPB_R = 0;
 
-    PWM0_2_CMPA_R = 1000;
+    setPwmDuty(1, 0, 0);
+    setPwmDuty(2, PWM_DUTY_MAX, 0);
+    commitPwm();
     waitMicrosecond(1000000);
-    PWM0_2_CMPA_R = 0;
 
-    PWM0_2_CMPB_R = 1000;
+    setPwmDuty(2, 0, PWM_DUTY_MAX);
+    commitPwm();
     waitMicrosecond(1000000);
-    PWM0_2_CMPB_R = 0;
+
+    setPwmDuty(2, 0, 0);
+    commitPwm();
 }
 
 void data_flush(USER_DATA * clear)
@@ -676,91 +1065,494 @@ void instruct_delete(instruction * arr, uint8_t remove, int8_t index, bool max)
     return;
 }
 
+// Start the current step; a running move has already been ramped down if the
+// step needs it
 void rb_run( instruction instruct )
 {
 	switch(instruct.command)
     {
     case 0:
-        rb_forward( instruct.argument );
+        rb_forward( instruct.argument, instruct.subcommand );
         break;
     case 1:
-        rb_reverse( instruct.argument );
+        rb_reverse( instruct.argument, instruct.subcommand );
         break;
     case 2:
-        rb_cwRotate( instruct.argument );
+        rb_cwRotate( instruct.argument, instruct.subcommand );
         break;
     case 3:
-        rb_ccwRotate( instruct.argument ); 
+        rb_ccwRotate( instruct.argument, instruct.subcommand ); 
         break;
     case 4:
-        rb_wait( instruct.argument, instruct.subcommand );
+        rb_wait( instruct.argument );
         break;
     case 5:
-        rb_pause( instruct.argument );
+        rb_pause( instruct.argument, instruct.subcommand );
         break;
     case 6:
         rb_stop();
         break;
+    case CMD_SCAN:
+        rb_scan();
+        break;
+    default:
+        rb_exec.phase = EXEC_DONE;
     }
-	return;
 }
 
-void pathFind()
+// Poll the step that is running
+uint8_t rb_poll( instruction instruct )
 {
-    rb_wait(0x1111, 0);
-    while(1)
+    switch(instruct.command)
     {
-        rb_forward(-1);
-        wait_distance(30);
-        rb_cwRotate(90);
+    case 4:
+        return rb_waiting( instruct.argument, instruct.subcommand );
+    case 5:
+        return rb_pausing();
+    case CMD_SCAN:
+        return rb_scanning();
     }
+    return rb_moving();
 }
 
-//-----------------------------------------------------------------------------
-// Main
-//-----------------------------------------------------------------------------
+// Load a program and wake the executor; false if a program is already running
+// The program is copied, so the queue can be edited while it runs
+bool rb_start( instruction * arr, uint8_t count, int8_t loop )
+{
+    uint32_t dist, latency;
+    uint8_t i;
 
-int main(void)
+    if(rb_exec.phase != EXEC_IDLE)
+        return false;
+    for(i = 0; i < count; i++)
+        rb_exec.program[i] = arr[i];
+    rb_exec.count = count;
+    rb_exec.loop = loop;
+    rb_exec.step = 0;
+    rb_exec.code = ERR_NONE;
+    rb_exec.cruise = 0;
+
+    clearTrace();
+    takeProtectStop(&dist, &latency);   // forget a stop from before this run
+    for(i = 0; i < 2; i++)
     {
-    USER_DATA data;
-    instruction inst_arr[MAX_INSTRUCTIONS];
-    int8_t inst_index = 0;
-    bool inst_max = false;
+        rb_stops[i].count = 0;
+        rb_stops[i].sum = 0;
+    }
+    rb_exec.phase = count ? EXEC_STEP : EXEC_IDLE;
+    rb_exec.eventWait = false;
+    queueSend(&controlQueue, CONTROL_START);
+    return true;
+}
 
-    initHw();
-    initUart0();
-    setUart0BaudRate(115200, 40e6);
-    SLEEP_PIN = 1;
-	
-	uint8_t i;
-	//pathFind();
+// Run the queue edited by the console once
+bool rb_runQueue()
+{
+    return rb_start( inst_arr, inst_max ? MAX_INSTRUCTIONS : inst_index, -1 );
+}
+
+bool isRunning()
+{
+    return rb_exec.phase != EXEC_IDLE;
+}
 
+// End of the program: report the failure and the stop-to-stop repeatability of
+// each stop mode
+void rb_finish()
+{
+    char output[60];
+    uint8_t last = rb_exec.step - 1;
+    uint8_t i;
+
+    if(rb_exec.cruise)
+    {
+        setMotionSpeed(rb_exec.cruise);
+        rb_exec.cruise = 0;
+    }
+    if(rb_exec.code != ERR_NONE)
+    {
+        sprintf(output, "step %d failed: %s\n", rb_exec.step, getErrorString(rb_exec.code));
+        putsUart0(output);
+    }
+    for(i = 0; i < 2; i++)
+    {
+        if(rb_stops[i].count == 0)
+            continue;
+        traceEvent(last, i ? TRACE_BRAKE_SPREAD : TRACE_COAST_SPREAD, ERR_NONE, rb_stops[i].max - rb_stops[i].min);
+        sprintf(output, "%s stops: %d, mean %u mm, spread %u mm\n", i ? "brake" : "coast",
+                rb_stops[i].count, rb_stops[i].sum / rb_stops[i].count, rb_stops[i].max - rb_stops[i].min);
+        putsUart0(output);
+    }
+    rb_exec.phase = EXEC_IDLE;
+}
+
+// Record the result and run time of the step that ended, then go on with the
+// next step or end the program at the first failure
+void rb_endStep()
+{
+    traceEvent(rb_exec.step, TRACE_STEP, rb_exec.code, getTimeMs() - rb_exec.start);
+    rb_exec.step++;
+    if(rb_exec.code != ERR_NONE || (rb_exec.step >= rb_exec.count && rb_exec.loop < 0))
+    {
+        rb_finish();
+        return;
+    }
+    if(rb_exec.step >= rb_exec.count)
+        rb_exec.step = rb_exec.loop;
+    rb_exec.phase = EXEC_STEP;
+}
+
+// Cut the current step short and go on with the next one
+// A move or a scan is ramped down and its poll ends the step as usual; a pause or a
+// wall wait ends at once. A button wait takes the press itself from SW1's events.
+void rb_next()
+{
+    instruction instruct = rb_exec.program[rb_exec.step];
+    if(rb_exec.phase != EXEC_WAIT)
+        return;
+    if(instruct.command == 4 && instruct.argument == 0x1111)
+        return;
+    if(instruct.command == 4 || instruct.command == 5)
+    {
+        RED_LED = 0;
+        rb_exec.phase = EXEC_DONE;
+    }
+    else if(isMoving())
+        stopMove(STOP_DEFAULT);
+}
+
+// Stop the program at the current step
+void rb_abort()
+{
+    if(rb_exec.phase == EXEC_IDLE)
+        return;
+    rb_exec.code = rb_fail(ERR_ABORT);
+    rb_endStep();
+}
+
+// True for the steps that drive the wheels, which need the H-bridge awake
+bool rb_drives( instruction instruct )
+{
+    return instruct.command <= 3 || instruct.command == CMD_SCAN;
+}
+
+// Advances the program through as many phases as it can without waiting
+void runExecutor()
+{
+    instruction instruct;
+    uint8_t phase;
+
+    if(rb_exec.phase == EXEC_IDLE)
+        return;
+    if(rb_protectStop() != ERR_NONE)
+    {
+        rb_exec.code = rb_fail(ERR_PROTECT);
+        rb_endStep();
+        return;
+    }
+    do
+    {
+        phase = rb_exec.phase;
+        instruct = rb_exec.program[rb_exec.step];
+        switch(phase)
+        {
+        case EXEC_STEP:
+            rb_exec.start = getTimeMs();
+            if(instruct.command == CMD_SCAN)
+                rb_rampDown(STOP_DEFAULT);
+            else if(instruct.command == 4 || instruct.command == 5)
+                rb_exec.phase = EXEC_ACTION;
+            else
+                rb_rampDown(instruct.subcommand);
+            break;
+        case EXEC_RAMP:
+            if(!isMoving())
+                rb_startSettle(EXEC_ACTION);
+            else if(deadlinePassed(rb_exec.deadline))
+                rb_exec.code = ERR_TIMEOUT;
+            break;
+        case EXEC_SETTLE:
+            rb_settle();
+            break;
+        case EXEC_ACTION:
+            if(rb_drives(instruct) && !wakeDriver())
+                rb_exec.phase = EXEC_WAKE;
+            else
+                rb_run(instruct);
+            break;
+        case EXEC_WAKE:
+            if(isDriverReady())
+                rb_exec.phase = EXEC_ACTION;
+            break;
+        case EXEC_WAIT:
+            rb_exec.code = rb_poll(instruct);
+            break;
+        case EXEC_DONE:
+            rb_endStep();
+            break;
+        }
+        if(rb_exec.code != ERR_NONE && rb_exec.phase != EXEC_IDLE)
+        {
+            rb_fail(rb_exec.code);
+            rb_endStep();
+        }
+    }
+    while(rb_exec.phase != phase && rb_exec.phase != EXEC_IDLE);
+}
+
+// Wait for the button, then drive until a wall is 30 cm ahead and turn right, forever
+void pathFind()
+{
+    instruction path[4] = {{4, 0, 0x1111}, {0, STOP_DEFAULT, 0xFFFF}, {4, 30, 0x2222}, {2, STOP_DEFAULT, 90}};
+    rb_start(path, 4, 1);
+}
+
+// True while the step in progress is a wait for the button, a wall or the end of a
+// pause with the wheels stopped; nothing changes until a message arrives
+bool rb_waitsForEvent()
+{
+    instruction instruct = rb_exec.program[rb_exec.step];
+    return rb_exec.phase == EXEC_WAIT && (instruct.command == 4 || instruct.command == 5) && !isMoving();
+}
+
+// Control thread: runs the messages from the other threads and the executor at the
+// highest priority. Moves are polled every EXECUTOR_PERIOD_MS; with no program or a
+// step that waits for an event the thread blocks on the queue, so the CPU can sleep.
+// The run clock is kept while a move is running, even one a finished program left
+// running, so the profile never sees the idle clock or deep sleep.
+// Any message, such as a button press, wakes the thread at once.
+void controlThread()
+{
+    uint32_t message = CONTROL_NONE;
+    bool block;
     while(true)
     {
-        putcUart0('>');
-        BLUE_LED = 1;
-        getsUart0(&data);
-        BLUE_LED = 0;
-        putcUart0('\n');
+        wait(&executorLock);
+        do
+        {
+            if(message == CONTROL_ABORT)
+                rb_abort();
+            else if(message == CONTROL_BUTTON && isRunning())
+                rb_next();
+            else if(message == CONTROL_BUTTON)
+                rb_runQueue();
+        }
+        while(queueTryReceive(&controlQueue, &message));
+        updatePowerMode(isRunning() || isMoving());
+        runExecutor();
+        updatePowerMode(isRunning() || isMoving());
+        rb_exec.eventWait = rb_waitsForEvent();
+        block = (!isRunning() && !isMoving()) || rb_exec.eventWait;
+        post(&executorLock);
+        if(block)
+            message = queueReceive(&controlQueue);
+        else if(!queueReceiveTimeout(&controlQueue, &message, EXECUTOR_PERIOD_MS))
+            message = CONTROL_NONE;
+    }
+}
 
-        parseFields(&data);
+// Ranging thread: woken by every new reading to trace it into the map; the only
+// thread that writes the map, so mapclear is handed to it as well
+void rangingThread()
+{
+    while(true)
+    {
+        wait(&rangeReady);
+        if(mapClearing)
+        {
+            mapClearing = false;
+            clearMap();
+        }
+        updateMap();
+    }
+}
 
+// Called from the ranging interrupt for every new result
+void rangeEvent()
+{
+    post(&rangeReady);
+    if(rb_exec.eventWait)
+        queueSend(&controlQueue, CONTROL_EVENT);
+}
 
-#ifdef DEBUG
-        putcUart0('\n');
-        for (i = 0; i < data.fieldCount; i++)
+// Called from the interrupt of every debounced button event
+// SW1 starts the queue or goes on with the next step, SW2 aborts the run
+void buttonEvent(uint8_t pin, uint8_t event)
+{
+    if(event != EVENT_PRESS)
+        return;
+    queueSend(&controlQueue, pin == EVENT_SW2 ? CONTROL_ABORT : CONTROL_BUTTON);
+}
+
+// Called from the UART interrupt when characters arrive
+void consoleEvent()
+{
+    post(&consoleReady);
+}
+
+// Called from the battery interrupt when the low-battery warning starts or ends;
+// the console thread prints it
+void batteryEvent(bool low)
+{
+    batteryChanged = true;
+    post(&consoleReady);
+}
+
+// Print the low-battery warning or its end
+void printBatteryWarning()
+{
+    char output[40];
+    batteryChanged = false;
+    sprintf(output, "battery %s: %u mV\n", isBatteryLow() ? "low" : "ok", getBatteryVoltage());
+    putsUart0(output);
+}
+
+// One line with the time, pose, wheel speeds, the four ranges (0 if invalid) and the
+// battery voltage, flagged while it is low
+void printTelemetry()
+{
+    char output[112];
+    uint32_t d[RANGE_SENSORS];
+    int32_t x, y;
+    uint16_t heading;
+    uint8_t valid, i;
+
+    valid = getRangeDistances(d);
+    for(i = 0; i < RANGE_SENSORS; i++)
+        if(!(valid & (1 << i)))
+            d[i] = 0;
+    getPose(&x, &y, &heading);
+    sprintf(output, "T %u ms: pose %d %d %u, wheels %u %u mm/s, range %u %u %u %u, bat %u mV%s\n", getTimeMs(),
+            x, y, heading, getWheelSpeed(0), getWheelSpeed(1), d[0], d[1], d[2], d[3],
+            getBatteryVoltage(), isBatteryLow() ? " LOW" : "");
+    putsUart0(output);
+}
+
+// Telemetry thread: one line every telemetry period
+void telemetryThread()
+{
+    while(true)
+    {
+        if(telemetryMs == 0)
+            wait(&telemetryWake);
+        else
         {
-            putcUart0(data.fieldType[i]);
-            putcUart0('\t');
-            putsUart0(&data.buffer[ data.fieldPosition[i] ]);
-            putcUart0('\n');
+            printTelemetry();
+            sleep(telemetryMs);
         }
-#endif
+    }
+}
+
+// Idle thread: runs when every other thread is blocked, so the watchdog is only
+// fed while no thread hogs the CPU; sleeps until the next interrupt in between
+void idleThread()
+{
+    while(true)
+    {
+        kickWatchdog();
+        sleepCpu();
+    }
+}
+
+char* threadStates[5] = {"-", "ready", "delayed", "blocked", "stopped"};
+
+// Prints the priority, state, bursts, longest burst, CPU share and stack use of
+// every thread, then starts the statistics over
+void printTasks()
+{
+    char output[80];
+    uint32_t cpu;
+    uint8_t i;
+    for(i = 0; i < getThreadCount(); i++)
+    {
+        cpu = getThreadCpu(i);
+        sprintf(output, "%-10s %d %-8s %8u runs, wcet %u us, cpu %u.%u%%, stack %u\n", getThreadName(i),
+                getThreadPriority(i), threadStates[getThreadState(i)], getThreadRuns(i), getThreadWcet(i),
+                cpu / 10, cpu % 10, getThreadStackUsed(i));
+        putsUart0(output);
+    }
+    sprintf(output, "%u switches\n", getSwitchCount());
+    putsUart0(output);
+    resetThreadStats();
+}
+
+char* powerModes[POWER_MODES] = {"idle", "run"};
+
+// Prints the clock, the switch latencies, the time spent in each power mode and how
+// much of it the core was awake; awake time times the clock of the mode is the number
+// of active cycles
+void printPower()
+{
+    char output[96];
+    POWER_STATS stats;
+    uint32_t awake, share, mhz;
+    uint8_t i;
+    getPowerStats(&stats);
+    sprintf(output, "%s at %u MHz, scaling %s, deep sleep %s\n", powerModes[getPowerMode()],
+            getSystemClock() / 1000000, isPowerScaling() ? "on" : "off", isDeepSleep() ? "on" : "off");
+    putsUart0(output);
+    for(i = 0; i < POWER_MODES; i++)
+    {
+        awake = stats.timeMs[i] - stats.sleepMs[i];
+        share = stats.timeMs[i] ? (uint64_t)awake * 1000 / stats.timeMs[i] : 0;
+        mhz = (i == POWER_IDLE ? F_IDLE : F_CPU) / 1000000;
+        sprintf(output, "%-4s %6u switches, last %u us, max %u us, %u s, awake %u.%u%%, %u Mcycles\n",
+                powerModes[i], stats.switches[i], stats.lastUs[i], stats.maxUs[i], stats.timeMs[i] / 1000,
+                share / 10, share % 10, (uint32_t)((uint64_t)awake * mhz / 1000));
+        putsUart0(output);
+    }
+}
+
+uint32_t benchDelays[8] = {250, 500, 1000, 2000, 5000, 10000, 100000, 500000};
+
+// Prints the requested and measured length of delays from 250 ns to 500 us
+void rb_benchDelay()
+{
+    char output[60];
+    uint32_t measured;
+    uint8_t i;
+    for(i = 0; i < 8; i++)
+    {
+        measured = benchDelay(benchDelays[i]);
+        sprintf(output, "delay %6u ns: %6u ns, error %d ns\n", benchDelays[i], measured,
+                (int32_t)(measured - benchDelays[i]));
+        putsUart0(output);
+    }
+}
+
+// Prints the context switch time and the interrupt latency in cycles and ns
+void rb_bench()
+{
+    char output[80];
+    BENCH_RESULT result;
+    benchContextSwitch(&result);
+    sprintf(output, "switch: min %u, mean %u, max %u cycles (%u ns mean)\n", result.min, result.mean, result.max,
+            result.mean * 1000 / (getSystemClock() / 1000000));
+    putsUart0(output);
+    benchInterruptLatency(&result);
+    sprintf(output, "irq latency: min %u, mean %u, max %u cycles (%u ns mean)\n", result.min, result.mean, result.max,
+            result.mean * 1000 / (getSystemClock() / 1000000));
+    putsUart0(output);
+}
+
+//-----------------------------------------------------------------------------
+// Console
+//-----------------------------------------------------------------------------
 
+USER_DATA data;
+uint8_t insertSpot = 0;         // step the next line is inserted at, 0 for a command
+
+// Runs one line that edits the queue; false if the line is another command
+// Called with executorLock held, so SW1 never starts a half-edited queue
+bool rb_edit()
+{
+    bool edited = false;
 
         if( isCommand(&data, "forward", 2) )
 		{
+            edited = true;
             inst_arr[inst_index].command = 0;
+            inst_arr[inst_index].subcommand = getStopModeField(&data);
             if( getFieldInteger(&data, 1) == -1 )
                 inst_arr[inst_index++].argument = 0xFFFF;
             else
@@ -770,7 +1562,9 @@ int main(void)
 		
 		if( isCommand(&data, "reverse", 2) )
 		{
+		    edited = true;
 		    inst_arr[inst_index].command = 1;
+		    inst_arr[inst_index].subcommand = getStopModeField(&data);
 		    if( getFieldInteger(&data, 1) == -1 )
 		        inst_arr[inst_index++].argument = 0xFFFF;
 		    else
@@ -780,7 +1574,9 @@ int main(void)
 		
 		if( isCommand(&data, "cw", 2) )
 		{
+		    edited = true;
 		    inst_arr[inst_index].command = 2;
+		    inst_arr[inst_index].subcommand = getStopModeField(&data);
 		    if( getFieldInteger(&data, 1) == -1 )
 		        inst_arr[inst_index++].argument = 0xFFFF;
 		    else
@@ -790,7 +1586,9 @@ int main(void)
 		
 		if( isCommand(&data, "ccw", 2) )
 		{
+		    edited = true;
 		    inst_arr[inst_index].command = 3;
+		    inst_arr[inst_index].subcommand = getStopModeField(&data);
 		    if( getFieldInteger(&data, 1) == -1 )
 		        inst_arr[inst_index++].argument = 0xFFFF;
 		    else
@@ -800,6 +1598,7 @@ int main(void)
 		
 		if( isCommand(&data, "wait", 2) )
 		{
+		    edited = true;
 		    inst_arr[inst_index].command = 4;
 		    if( strcomp(getFieldString(&data, 1), "pb") )
 		    {
@@ -818,18 +1617,42 @@ int main(void)
 		
 		if( isCommand(&data, "pause", 2) )
 		{
+		    edited = true;
 		    inst_arr[inst_index].command = 5;
+		    inst_arr[inst_index].subcommand = getPauseUnitField(&data);
 		    inst_arr[inst_index++].argument = getFieldInteger(&data, 1);
 			//rb_pause( getFieldInteger(&data, 1) );
 		}
 		
 		if( isCommand(&data, "stop", 1) )
 		{
+		    edited = true;
 		    inst_arr[inst_index].command = 6;
+		    inst_arr[inst_index].subcommand = getStopModeField(&data);
 		    inst_arr[inst_index++].argument = getFieldInteger(&data, 1);
 			//rb_stop();
 		}
 
+		if( isCommand(&data, "delete", 2) )
+		{
+		    edited = true;
+		    instruct_delete(inst_arr, getFieldInteger(&data, 1), inst_index--, inst_max);
+		    if(inst_max)
+		    {
+		        inst_index = MAX_INSTRUCTIONS - 1;
+		        inst_max = false;
+		    }
+		}
+
+    return edited;
+}
+
+// Runs one command line
+void rb_command()
+{
+	uint8_t i;
+
+
 		if( isCommand(&data, "list", 1) )
 		{
 		    if(inst_max)
@@ -840,44 +1663,199 @@ int main(void)
 		            comm2str(inst_arr[i], i);
 		}
 
-		if( isCommand(&data, "insert", 2) )
+		if( isCommand(&data, "status", 1) )
+		    rb_status();
+
+		if( isCommand(&data, "scan", 2) )
+		{
+		    instruction scan = {CMD_SCAN, 0, 0};
+		    wait(&executorLock);
+		    if(isRunning())
+		        putsUart0("busy\n");
+		    else if(!startScan( getFieldInteger(&data, 1) ))
+		        putsUart0("invalid step\n");
+		    else
+		        rb_start(&scan, 1, -1);
+		    post(&executorLock);
+		}
+
+		if( isCommand(&data, "scandump", 1) )
+		    dumpScan();
+
+		if( isCommand(&data, "map", 1) )
+		    streamMap();
+
+		if( isCommand(&data, "mapclear", 1) )
 		{
-		    uint8_t spot = getFieldInteger(&data, 1);
+		    // The ranging thread owns the map; it preempts us and clears it at once
+		    mapClearing = true;
+		    post(&rangeReady);
+		}
+
+		if( isCommand(&data, "set", 2) )
+		    rb_set( getFieldString(&data, 1), getFieldInteger(&data, 2) );
 
+		if( isCommand(&data, "insert", 2) )
+		{
+		    // The command to insert is the next line
+		    insertSpot = getFieldInteger(&data, 1);
 		    putsUart0("insert command: ");
-		    getsUart0(&data);
-		    putcUart0('\n');
-		    parseFields(&data);
-		    instruction inserting = comm2instruct(data);
+		}
 
-		    instruct_insert(inst_arr, inserting, spot, inst_index++, inst_max);
+		if( isCommand(&data, "run", 1) )
+		{
+		    wait(&executorLock);
+			if( !rb_runQueue() )
+		        putsUart0("busy\n");
+		    post(&executorLock);
 		}
 
-		if( isCommand(&data, "delete", 2) )
+		if( isCommand(&data, "abort", 1) )
+		    queueSend(&controlQueue, CONTROL_ABORT);
+
+		if( isCommand(&data, "trace", 1) )
+		    printTrace();
+
+		if( isCommand(&data, "telemetry", 2) )
 		{
-		    instruct_delete(inst_arr, getFieldInteger(&data, 1), inst_index--, inst_max);
-		    if(inst_max)
+		    if( getFieldInteger(&data, 1) < 0 )
+		        putsUart0("invalid value\n");
+		    else
 		    {
-		        inst_index = MAX_INSTRUCTIONS - 1;
-		        inst_max = false;
+		        telemetryMs = getFieldInteger(&data, 1);
+		        post(&telemetryWake);
 		    }
 		}
-		
-		if( isCommand(&data, "run", 1) )
+
+		if( isCommand(&data, "tasks", 1) )
+		    printTasks();
+
+		if( isCommand(&data, "bench", 1) )
 		{
-			if(inst_max)
-		        for(i = 0; i < MAX_INSTRUCTIONS; i++)
-		            rb_run( inst_arr[i] );
+		    if( data.fieldCount > 1 && strcomp(getFieldString(&data, 1), "delay") )
+		        rb_benchDelay();
 		    else
-		        for(i = 0; i < inst_index; i++)
-		            rb_run( inst_arr[i] );
+		        rb_bench();
 		}
 
-		if(inst_index % MAX_INSTRUCTIONS == 0)
+		if( isCommand(&data, "power", 1) )
 		{
-		    inst_index = inst_index % MAX_INSTRUCTIONS;
-		    inst_max = true;
+		    if( data.fieldCount > 1 && strcomp(getFieldString(&data, 1), "on") )
+		        setPowerScaling(true);
+		    else if( data.fieldCount > 1 && strcomp(getFieldString(&data, 1), "off") )
+		        setPowerScaling(false);
+		    else if( data.fieldCount > 2 && strcomp(getFieldString(&data, 1), "deep") )
+		        setDeepSleep(strcomp(getFieldString(&data, 2), "on"));
+		    else
+		        printPower();
 		}
-		data_flush(&data);
+}
+
+// Takes the characters that have arrived and runs the line once it is complete
+void runConsole()
+{
+    bool edited;
+#ifdef DEBUG
+    uint8_t i;
+#endif
+
+    if(!getsUart0(&data))
+        return;
+    BLUE_LED = 0;
+    putcUart0('\n');
+    parseFields(&data);
+
+#ifdef DEBUG
+        putcUart0('\n');
+        for (i = 0; i < data.fieldCount; i++)
+        {
+            putcUart0(data.fieldType[i]);
+            putcUart0('\t');
+            putsUart0(&data.buffer[ data.fieldPosition[i] ]);
+            putcUart0('\n');
+        }
+#endif
+
+    wait(&executorLock);
+    if(insertSpot)
+    {
+        instruction inserting = comm2instruct(data);
+
+        instruct_insert(inst_arr, inserting, insertSpot, inst_index++, inst_max);
+        insertSpot = 0;
+        edited = true;
     }
+    else
+        edited = rb_edit();
+
+    if(inst_index % MAX_INSTRUCTIONS == 0)
+    {
+        inst_index = inst_index % MAX_INSTRUCTIONS;
+        inst_max = true;
+    }
+    post(&executorLock);
+
+    if(!edited)
+        rb_command();
+    data_flush(&data);
+
+    if(insertSpot == 0)
+    {
+        putcUart0('>');
+        BLUE_LED = 1;
+    }
+}
+
+// Console thread: woken by the UART interrupt, it runs every line that has arrived at
+// low priority, so long commands are preempted by the control loop; a change of the
+// low-battery warning wakes it too
+void consoleThread()
+{
+    while(true)
+    {
+        wait(&consoleReady);
+        if(batteryChanged)
+            printBatteryWarning();
+        while(kbhitUart0())
+            runConsole();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Main
+//-----------------------------------------------------------------------------
+
+int main(void)
+    {
+    initHw();
+    initUart0();
+    setUart0BaudRate(UART0_BAUD_RATE, getSystemClock());
+
+    clearMap();
+
+    if(SYSCTL_RESC_R & SYSCTL_RESC_WDT0)
+        putsUart0("Watchdog reset\n");
+    SYSCTL_RESC_R = 0;
+
+    initSemaphore(&executorLock, 1);
+    initSemaphore(&rangeReady, 0);
+    initSemaphore(&consoleReady, 0);
+    initSemaphore(&telemetryWake, 0);
+    initQueue(&controlQueue);
+    createThread(controlThread, "control", CONTROL_PRIORITY, CONTROL_STACK_BYTES);
+    createThread(rangingThread, "ranging", RANGING_PRIORITY, RANGING_STACK_BYTES);
+    createThread(consoleThread, "console", CONSOLE_PRIORITY, CONSOLE_STACK_BYTES);
+    createThread(telemetryThread, "telemetry", TELEMETRY_PRIORITY, TELEMETRY_STACK_BYTES);
+    createThread(idleThread, "idle", IDLE_PRIORITY, IDLE_STACK_BYTES);
+    initBench();
+    setRangeCallback(rangeEvent);
+    setUart0RxCallback(consoleEvent);
+    setEventCallback(buttonEvent);
+    setBatteryCallback(batteryEvent);
+
+	//pathFind();
+
+    putcUart0('>');
+    BLUE_LED = 1;
+    startKernel();
 }
@@ -7,7 +7,7 @@
 
 // Target Platform: EK-TM4C123GXL with LCD Interface
 // Target uC:       TM4C123GH6PM
-// System Clock:    40 MHz
+// System Clock:    80 MHz
 
 // Hardware configuration:
 // Red Backlight LED:
@@ -22,7 +22,9 @@
 //-----------------------------------------------------------------------------
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "tm4c123gh6pm.h"
+#include "clock.h"
 #include "pwm.h"
 
 // PortB masks
@@ -37,16 +39,34 @@
 #define GREEN_BL_LED_MASK 32
 
 
+// PWM clock dividers selectable in RCC, finest first
+#define PWM_DIVIDERS 7
+
+// Generator actions; the outputs are inverted, so the pin is high from the compare
+// match down to zero. Full duty drives the output low at the load as well, which
+// keeps the pin high for the whole period.
+#define GENA_PWM  (PWM_0_GENA_ACTCMPAD_ZERO | PWM_0_GENA_ACTLOAD_ONE)
+#define GENB_PWM  (PWM_0_GENB_ACTCMPBD_ZERO | PWM_0_GENB_ACTLOAD_ONE)
+#define GENA_HIGH (PWM_0_GENA_ACTCMPAD_ZERO | PWM_0_GENA_ACTLOAD_ZERO)
+#define GENB_HIGH (PWM_0_GENB_ACTCMPBD_ZERO | PWM_0_GENB_ACTLOAD_ZERO)
+
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
 
+uint16_t pwmLoad = 1024;            // generator load value, a period is pwmLoad + 1 counts
+uint32_t pwmFrequency = 0;
+uint16_t pwmDuty[2][2];             // last normalized duty of outputs A and B, generators 1 and 2
+const uint32_t pwmDividers[PWM_DIVIDERS] =
+    {0, SYSCTL_RCC_PWMDIV_2, SYSCTL_RCC_PWMDIV_4, SYSCTL_RCC_PWMDIV_8,
+     SYSCTL_RCC_PWMDIV_16, SYSCTL_RCC_PWMDIV_32, SYSCTL_RCC_PWMDIV_64};
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-// Initialize backlight
-void initPWM()
+// Initialize the motor PWM outputs at the given frequency
+void initPWM(uint32_t frequencyHz)
 {
 
     // Configure three backlight LEDs
@@ -73,24 +93,144 @@ void initPWM()
     PWM0_1_CTL_R = 0;                                // turn-off PWM0 generator 1 (drives outs 2 and 3)
     PWM0_2_CTL_R = 0;                                // turn-off PWM0 generator 2 (drives outs 4 and 5)
 
-    PWM0_1_GENA_R = PWM_0_GENA_ACTCMPAD_ZERO | PWM_0_GENA_ACTLOAD_ONE;
-    PWM0_1_GENB_R = PWM_0_GENB_ACTCMPBD_ZERO | PWM_0_GENB_ACTLOAD_ONE;
+    PWM0_1_GENA_R = GENA_PWM;
+    PWM0_1_GENB_R = GENB_PWM;
                                                      // output 3 on PWM0, gen 1b, cmpb
-    PWM0_2_GENA_R = PWM_0_GENA_ACTCMPAD_ZERO | PWM_0_GENA_ACTLOAD_ONE;
+    PWM0_2_GENA_R = GENA_PWM;
                                                      // output 4 on PWM0, gen 2a, cmpa
-    PWM0_2_GENB_R = PWM_0_GENB_ACTCMPBD_ZERO | PWM_0_GENB_ACTLOAD_ONE;
+    PWM0_2_GENB_R = GENB_PWM;
                                                      // output 5 on PWM0, gen 2b, cmpb
-    PWM0_1_LOAD_R = 1024;                            // set frequency to 40 MHz sys clock / 2 / 1024 = 19.53125 kHz
-    PWM0_2_LOAD_R = 1024;
+    PWM0_1_LOAD_R = pwmLoad;                         // 80 MHz sys clock / 1025 = 78 kHz until the frequency is set
+    PWM0_2_LOAD_R = pwmLoad;
     PWM0_INVERT_R = PWM_INVERT_PWM2INV | PWM_INVERT_PWM3INV | PWM_INVERT_PWM4INV | PWM_INVERT_PWM5INV;
                                                      // invert outputs so duty cycle increases with increasing compare values
-    PWM0_1_CMPB_R = 0;                               // red off (0=always low, 1023=always high)
+    PWM0_1_CMPB_R = 0;                               // red off (always on is set by the generator action)
     PWM0_2_CMPB_R = 0;                               // green off
     PWM0_2_CMPA_R = 0;                               // blue off
     PWM0_1_CMPA_R = 0;
 
-    PWM0_1_CTL_R = PWM_0_CTL_ENABLE;                 // turn-on PWM0 generator 1
-    PWM0_2_CTL_R = PWM_0_CTL_ENABLE;                 // turn-on PWM0 generator 2
+    PWM0_1_CTL_R = PWM_0_CTL_ENABLE | PWM_0_CTL_CMPAUPD | PWM_0_CTL_CMPBUPD | PWM_0_CTL_LOADUPD
+                 | PWM_0_CTL_GENAUPD_GS | PWM_0_CTL_GENBUPD_GS;
+                                                     // turn-on PWM0 generator 1, compare, load and
+                                                     // action updates wait for a global sync
+    PWM0_2_CTL_R = PWM_0_CTL_ENABLE | PWM_0_CTL_CMPAUPD | PWM_0_CTL_CMPBUPD | PWM_0_CTL_LOADUPD
+                 | PWM_0_CTL_GENAUPD_GS | PWM_0_CTL_GENBUPD_GS;
+                                                     // turn-on PWM0 generator 2, same update mode
+    PWM0_SYNC_R = PWM_SYNC_SYNC1 | PWM_SYNC_SYNC2;   // reset both counters so their periods line up
     PWM0_ENABLE_R = PWM_ENABLE_PWM2EN | PWM_ENABLE_PWM3EN | PWM_ENABLE_PWM4EN | PWM_ENABLE_PWM5EN;
                                                      // enable outputs
+    setPwmFrequency(frequencyHz);
+}
+
+// Converts a normalized duty to a compare value for the current load
+// A compare equal to the load never matches, the load action wins, so duties just
+// below full are held one count short of it; full duty is set by the generator
+// action instead, see setPwmDuty()
+uint16_t dutyToCompare(uint16_t duty)
+{
+    uint32_t compare = ((uint32_t)duty * (pwmLoad + 1)) >> PWM_DUTY_BITS;
+    if (compare > (uint32_t)pwmLoad - 1)
+        compare = (uint32_t)pwmLoad - 1;
+    return compare;
+}
+
+// Returns the counts of one period at the given clock with the finest PWM clock divider
+// that fits the period in the 16-bit load, or 0 if even the coarsest does not
+uint32_t getPwmCounts(uint32_t clockHz, uint32_t frequencyHz, uint8_t* divider)
+{
+    uint32_t counts;
+    uint8_t i;
+    for (i = 0; i < PWM_DIVIDERS; i++)
+    {
+        counts = (clockHz >> i) / frequencyHz;
+        if (counts <= 0x10000)
+        {
+            *divider = i;
+            return counts;
+        }
+    }
+    return 0;
+}
+
+// Program the divider and load of the set frequency for the current system clock
+// The staged duties are rescaled to the new period and everything is committed on
+// the next global sync. A frequency above F_IDLE / PWM_MIN_RESOLUTION is too fast for
+// the idle clock; the motors never run idle, so the period is stretched to
+// PWM_MIN_RESOLUTION counts until the run clock is back.
+void updatePwmClock()
+{
+    uint32_t counts;
+    uint8_t i = 0;
+
+    if (pwmFrequency == 0)
+        return;
+    counts = getPwmCounts(getSystemClock(), pwmFrequency, &i);
+    if (counts < PWM_MIN_RESOLUTION)
+        counts = PWM_MIN_RESOLUTION;
+    SYSCTL_RCC_R &= ~(SYSCTL_RCC_USEPWMDIV | SYSCTL_RCC_PWMDIV_M);
+    if (i > 0)
+        SYSCTL_RCC_R |= SYSCTL_RCC_USEPWMDIV | pwmDividers[i];
+    pwmLoad = counts - 1;
+    PWM0_1_LOAD_R = pwmLoad;
+    PWM0_2_LOAD_R = pwmLoad;
+    setPwmDuty(1, pwmDuty[0][0], pwmDuty[0][1]);
+    setPwmDuty(2, pwmDuty[1][0], pwmDuty[1][1]);
+    commitPwm();
+}
+
+// Set the switching frequency of both generators
+// The frequency is checked against the run clock F_CPU, the one the motors run at,
+// so the same setting holds after every clock switch
+// Returns false if the frequency cannot be generated with at least PWM_MIN_RESOLUTION counts
+bool setPwmFrequency(uint32_t frequencyHz)
+{
+    uint8_t divider;
+    if (frequencyHz == 0 || getPwmCounts(F_CPU, frequencyHz, &divider) < PWM_MIN_RESOLUTION)
+        return false;
+    pwmFrequency = frequencyHz;
+    updatePwmClock();
+    return true;
+}
+
+uint32_t getPwmFrequency()
+{
+    return pwmFrequency;
+}
+
+// Returns the number of compare steps in one period
+uint16_t getPwmResolution()
+{
+    return pwmLoad + 1;
+}
+
+// Stage new normalized duties (0 to PWM_DUTY_MAX) for generator 1 or 2
+// PWM_DUTY_MAX is always on for the whole period
+// Nothing changes on the outputs until commitPwm() is called
+void setPwmDuty(uint8_t generator, uint16_t dutyA, uint16_t dutyB)
+{
+    if (generator == 1)
+    {
+        PWM0_1_CMPA_R = dutyToCompare(dutyA);
+        PWM0_1_CMPB_R = dutyToCompare(dutyB);
+        PWM0_1_GENA_R = dutyA >= PWM_DUTY_MAX ? GENA_HIGH : GENA_PWM;
+        PWM0_1_GENB_R = dutyB >= PWM_DUTY_MAX ? GENB_HIGH : GENB_PWM;
+    }
+    else if (generator == 2)
+    {
+        PWM0_2_CMPA_R = dutyToCompare(dutyA);
+        PWM0_2_CMPB_R = dutyToCompare(dutyB);
+        PWM0_2_GENA_R = dutyA >= PWM_DUTY_MAX ? GENA_HIGH : GENA_PWM;
+        PWM0_2_GENB_R = dutyB >= PWM_DUTY_MAX ? GENB_HIGH : GENB_PWM;
+    }
+    else
+        return;
+    pwmDuty[generator - 1][0] = dutyA;
+    pwmDuty[generator - 1][1] = dutyB;
+}
+
+// Apply everything staged on both generators at their next common counter reload
+// Both counters were reset together, so both motors change on the same period
+void commitPwm()
+{
+    PWM0_CTL_R = PWM_CTL_GLOBALSYNC1 | PWM_CTL_GLOBALSYNC2;
 }
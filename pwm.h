@@ -7,7 +7,7 @@
 
 // Target Platform: EK-TM4C123GXL with LCD Interface
 // Target uC:       TM4C123GH6PM
-// System Clock:    40 MHz
+// System Clock:    80 MHz
 
 // Hardware configuration:
 // Red Backlight LED:
@@ -24,10 +24,23 @@
 #ifndef PWM_H_
 #define PWM_H_
 
+// Duty cycles are unsigned Q15: PWM_DUTY_MAX is always on
+#define PWM_DUTY_BITS 15
+#define PWM_DUTY_MAX  (1 << PWM_DUTY_BITS)
+
+#define PWM_DEFAULT_FREQUENCY_HZ 20000  // above the audible range
+#define PWM_MIN_RESOLUTION       100    // compare steps per period
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-void initPWM();
+void initPWM(uint32_t frequencyHz);
+bool setPwmFrequency(uint32_t frequencyHz);
+void updatePwmClock(void);
+uint32_t getPwmFrequency(void);
+uint16_t getPwmResolution(void);
+void setPwmDuty(uint8_t generator, uint16_t dutyA, uint16_t dutyB);
+void commitPwm();
 
 #endif
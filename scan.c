@@ -0,0 +1,127 @@
+// Scan Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Uses the odometry, motion and ultrasonic libraries
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "odometry.h"
+#include "motion.h"
+#include "ultrasonic.h"
+#include "uart0.h"
+#include "scan.h"
+
+// Tenths of a degree in one revolution
+#define DECIDEG_PER_REV 3600
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+SCAN_POINT scanPoints[MAX_SCAN_POINTS];
+uint16_t scanStep;              // bin width, tenths of a degree
+uint16_t scanCount;             // bins in the current scan
+uint16_t scanFilled;            // bins with a reading
+uint32_t scanSequence;          // front sensor sequence of the last reading used
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Clear the polar array for a scan with bins of the given width
+// A step that does not divide 360 gets a narrower last bin, so the whole turn is kept
+// The rotation itself is started by the caller; odometry must be reset with it
+bool startScan(uint16_t stepDeg)
+{
+    uint16_t i;
+    if (stepDeg < SCAN_MIN_STEP_DEG || stepDeg > 360)
+        return false;
+    scanStep = stepDeg * 10;
+    scanCount = (360 + stepDeg - 1) / stepDeg;
+    scanFilled = 0;
+    for (i = 0; i < scanCount; i++)
+    {
+        scanPoints[i].angle = i * scanStep;
+        scanPoints[i].distance = 0;
+    }
+    scanSequence = getRangeSequence(RANGE_FRONT);
+    return true;
+}
+
+// Returns the heading since the start of the scan in tenths of a degree
+// Both wheels are averaged and interpolated between ticks, so the heading moves
+// smoothly instead of in 4.5 degree steps
+uint16_t getScanHeading()
+{
+    uint32_t position = (getOdometryPosition(MOTOR_LEFT) + getOdometryPosition(MOTOR_RIGHT)) / 2;
+    uint32_t heading = position * DECIDEG_PER_REV / (SCAN_TICKS_PER_REV << 8);
+    return heading < DECIDEG_PER_REV ? heading : DECIDEG_PER_REV - 1;
+}
+
+// Call while the scan rotation runs
+// Each new valid front reading goes into the bin of the current heading; the first
+// reading of a bin is kept so the bins are not smeared by later ones
+void updateScan()
+{
+    uint32_t sequence = getRangeSequence(RANGE_FRONT);
+    uint16_t heading, bin;
+    if (sequence == scanSequence)
+        return;
+    scanSequence = sequence;
+    if (!isRangeValid(RANGE_FRONT))
+        return;
+    heading = getScanHeading();
+    bin = heading / scanStep;
+    if (bin >= scanCount || scanPoints[bin].distance != 0)
+        return;
+    scanPoints[bin].angle = heading;
+    scanPoints[bin].distance = getRangeDistance(RANGE_FRONT);
+    scanFilled++;
+}
+
+uint16_t getScanCount()
+{
+    return scanCount;
+}
+
+uint16_t getScanFilled()
+{
+    return scanFilled;
+}
+
+SCAN_POINT getScanPoint(uint16_t index)
+{
+    return scanPoints[index];
+}
+
+// Send the polar array in binary
+// 'S', 'C', count (2 bytes), then angle and distance of each point (2 bytes each),
+// then the 8-bit sum of every byte after the header; all values little endian
+void dumpScan()
+{
+    uint8_t sum = 0, *p = (uint8_t *)scanPoints;
+    uint16_t i;
+    putcUart0('S');
+    putcUart0('C');
+    putcUart0(scanCount & 0xFF);
+    putcUart0(scanCount >> 8);
+    for (i = 0; i < scanCount * sizeof(SCAN_POINT); i++)
+    {
+        putcUart0(p[i]);
+        sum += p[i];
+    }
+    putcUart0(sum);
+}
@@ -0,0 +1,46 @@
+// Scan Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Uses the odometry, motion and ultrasonic libraries
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef SCAN_H_
+#define SCAN_H_
+
+#define SCAN_TICKS_PER_REV   80     // in-place cw rotation, 20 ticks per 90 degrees
+#define SCAN_SPEED           100    // wheel speed while scanning, mm/s (about 60 deg/s)
+#define SCAN_MIN_STEP_DEG    1
+#define MAX_SCAN_POINTS      (360 / SCAN_MIN_STEP_DEG)
+
+// One reading of a scan, 4 bytes
+typedef struct _SCAN_POINT
+{
+    uint16_t angle;         // heading of the reading, tenths of a degree cw from the start
+    uint16_t distance;      // filtered front distance in mm, 0 if the bin got no valid reading
+} SCAN_POINT;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+bool startScan(uint16_t stepDeg);
+void updateScan(void);
+uint16_t getScanHeading(void);
+uint16_t getScanCount(void);
+uint16_t getScanFilled(void);
+SCAN_POINT getScanPoint(uint16_t index);
+void dumpScan(void);
+
+#endif
@@ -0,0 +1,120 @@
+// Supervisor Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Time base:
+//   WTIMER2A counts microseconds for short measurements
+//   Deadlines use the millisecond clock of the timer service
+// Watchdog:
+//   WDT0 stops the motors on the first timeout and resets on the second
+// Motor driver:
+//   SLEEP (PB6) through the driver library
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "clock.h"
+#include "driver.h"
+#include "motion.h"
+#include "timer.h"
+#include "supervisor.h"
+
+#define COUNTS_PER_US (getSystemClock() / 1000000)
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+char* errorStrings[ERR_COUNT] = {"ok", "stall", "timeout", "no echo", "protective stop", "aborted"};
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Initialize the deadline time base and the watchdog
+void initSupervisor()
+{
+    // Enable clocks
+    SYSCTL_RCGCWTIMER_R |= SYSCTL_RCGCWTIMER_R2;
+    SYSCTL_RCGCWD_R |= SYSCTL_RCGCWD_R0;
+    _delay_cycles(3);
+
+    // Free-running microsecond counter
+    WTIMER2_CTL_R &= ~TIMER_CTL_TAEN;                   // turn-off timer before reconfiguring
+    WTIMER2_CFG_R = 4;                                  // configure as 32-bit timer (A only)
+    WTIMER2_TAMR_R = TIMER_TAMR_TAMR_PERIOD;            // configure for periodic mode (count down)
+    WTIMER2_TAPR_R = COUNTS_PER_US - 1;                 // prescale to 1 MHz
+    WTIMER2_TAILR_R = 0xFFFFFFFF;
+    WTIMER2_IMR_R = 0;                                  // turn-off interrupts
+    WTIMER2_CTL_R |= TIMER_CTL_TAEN;
+
+    // Watchdog: interrupt on the first timeout, reset on the second
+    WATCHDOG0_LOAD_R = WATCHDOG_TIMEOUT_US * COUNTS_PER_US;
+    WATCHDOG0_CTL_R = WDT_CTL_RESEN | WDT_CTL_INTEN;
+    NVIC_EN0_R |= 1 << (INT_WATCHDOG-16);
+}
+
+// Keep the microsecond counter and the watchdog timeout after the system clock changed
+void updateSupervisorClock()
+{
+    WTIMER2_TAPR_R = COUNTS_PER_US - 1;
+    kickWatchdog();
+}
+
+// Returns the free-running time in microseconds (wraps every 71 minutes)
+uint32_t getTimeUs()
+{
+    return ~WTIMER2_TAV_R;
+}
+
+// Returns a deadline the given number of milliseconds from now
+uint32_t makeDeadline(uint32_t ms)
+{
+    return getTimeMs() + ms;
+}
+
+// Returns true once a deadline is in the past
+bool deadlinePassed(uint32_t deadline)
+{
+    return (int32_t)(getTimeMs() - deadline) >= 0;
+}
+
+// Reload the watchdog; must be called at least once per WATCHDOG_TIMEOUT_US
+void kickWatchdog()
+{
+    WATCHDOG0_LOAD_R = WATCHDOG_TIMEOUT_US * COUNTS_PER_US;
+}
+
+// Turn off both motors and put the H-bridge to sleep
+void failSafe()
+{
+    haltMotors();
+    sleepDriver();
+}
+
+char* getErrorString(uint8_t code)
+{
+    if (code < ERR_COUNT)
+        return errorStrings[code];
+    return "?";
+}
+
+// The watchdog was not kicked for a full timeout
+// The interrupt is left pending so the next timeout resets the part
+void watchdogIsr()
+{
+    failSafe();
+    NVIC_DIS0_R = 1 << (INT_WATCHDOG-16);
+}
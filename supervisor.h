@@ -0,0 +1,61 @@
+// Supervisor Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Time base:
+//   WTIMER2A counts microseconds for short measurements
+//   Deadlines use the millisecond clock of the timer service
+// Watchdog:
+//   WDT0 stops the motors on the first timeout and resets on the second
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef SUPERVISOR_H_
+#define SUPERVISOR_H_
+
+// Error codes returned by blocking waits and the instruction executor
+#define ERR_NONE     0
+#define ERR_STALL    1      // a wheel stopped making progress
+#define ERR_TIMEOUT  2      // a move did not finish before its deadline
+#define ERR_ECHO     3      // the ultrasonic sensor never answered
+#define ERR_PROTECT  4      // a forward move entered the protective-stop zone
+#define ERR_ABORT    5      // the run was aborted
+#define ERR_COUNT    6
+
+// Deadlines, in milliseconds
+#define STALL_INTERVAL_MS        300        // a wheel must move within this interval
+#define STALL_GRACE_MS           500        // spin-up time before the first check
+#define MOVE_BASE_TIMEOUT_MS     2000
+#define MOVE_TICK_TIMEOUT_MS     60         // allowed time per odometry tick
+
+// Hardware timeouts, in microseconds
+#define WATCHDOG_TIMEOUT_US      1000000
+#define ECHO_START_TIMEOUT_US    10000      // trigger to echo rising edge
+#define ECHO_WIDTH_TIMEOUT_US    40000      // echo high this long means no object
+#define ECHO_MAX_MISSES          3
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initSupervisor(void);
+void updateSupervisorClock(void);
+uint32_t getTimeUs(void);
+uint32_t makeDeadline(uint32_t ms);
+bool deadlinePassed(uint32_t deadline);
+void kickWatchdog(void);
+void failSafe(void);
+char* getErrorString(uint8_t code);
+void watchdogIsr(void);
+
+#endif
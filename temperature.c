@@ -0,0 +1,85 @@
+// Temperature Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Temperature sensor:
+//   Internal sensor (TS) read by ADC0 sample sequencer 3
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "temperature.h"
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+volatile int32_t temperature;       // filtered, tenths of a degree C scaled by 2^TEMP_FILTER_SHIFT
+volatile bool temperatureValid = false;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Initialize ADC0 sample sequencer 3 to read the internal temperature sensor
+void initTemperature()
+{
+    SYSCTL_RCGCADC_R |= SYSCTL_RCGCADC_R0;
+    _delay_cycles(16);
+
+    ADC0_ACTSS_R &= ~ADC_ACTSS_ASEN3;                   // disable sample sequencer 3 (SS3) for programming
+    ADC0_CC_R = ADC_CC_CS_PIOSC;                        // 16 MHz PIOSC, keeps converting while the PLL is off
+    ADC0_EMUX_R = ADC_EMUX_EM3_PROCESSOR;               // select SS3 bit in ADCPSSI as trigger
+    ADC0_SSMUX3_R = 0;
+    ADC0_SSCTL3_R = ADC_SSCTL3_TS0 | ADC_SSCTL3_IE0 | ADC_SSCTL3_END0;
+                                                        // temperature sensor, interrupt at end of sequence
+    ADC0_SAC_R = ADC_SAC_AVG_64X;                       // 64-sample hardware averaging
+    ADC0_ISC_R = ADC_ISC_IN3;
+    ADC0_IM_R |= ADC_IM_MASK3;
+    NVIC_EN0_R |= 1 << (INT_ADC0SS3-16);
+    ADC0_ACTSS_R |= ADC_ACTSS_ASEN3;                    // enable SS3 for operation
+}
+
+// Start a conversion; the result is filtered in the interrupt
+void startTemperatureSample()
+{
+    ADC0_PSSI_R = ADC_PSSI_SS3;
+}
+
+bool isTemperatureValid()
+{
+    return temperatureValid;
+}
+
+// Returns the filtered temperature in tenths of a degree C
+int16_t getTemperature()
+{
+    return temperature >> TEMP_FILTER_SHIFT;
+}
+
+// TEMP = 147.5 - 75 * VREFP * raw / 4096, with VREFP = 3.3 V
+void adc0Ss3Isr()
+{
+    int32_t sample;
+    ADC0_ISC_R = ADC_ISC_IN3;
+    sample = (1475 - (2475 * (int32_t)(ADC0_SSFIFO3_R & 0xFFF)) / 4096) << TEMP_FILTER_SHIFT;
+    if (!temperatureValid)
+    {
+        temperature = sample;
+        temperatureValid = true;
+    }
+    else
+        temperature += (sample - temperature) >> TEMP_FILTER_SHIFT;
+}
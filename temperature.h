@@ -0,0 +1,35 @@
+// Temperature Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Temperature sensor:
+//   Internal sensor (TS) read by ADC0 sample sequencer 3
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef TEMPERATURE_H_
+#define TEMPERATURE_H_
+
+#define TEMP_FILTER_SHIFT 3     // IIR weight of a new sample is 1/8
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initTemperature(void);
+void startTemperatureSample(void);
+bool isTemperatureValid(void);
+int16_t getTemperature(void);
+void adc0Ss3Isr(void);
+
+#endif
@@ -0,0 +1,170 @@
+// Timer Service Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// SysTick:
+//   Interrupts every millisecond to advance the clock and the software timers
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "clock.h"
+#include "kernel.h"
+#include "timer.h"
+
+typedef struct _TIMER
+{
+    _callback callback;     // 0 for a free slot
+    uint32_t period;        // ms, 0 for a one-shot
+    uint32_t reload;        // ms the timer was started with
+    uint32_t remaining;     // ms until the callback
+} TIMER;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+volatile uint32_t timeMs = 0;
+volatile TIMER timers[NUM_TIMERS];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Start the 1 kHz SysTick interrupt
+void initTimer()
+{
+    uint8_t i;
+    for (i = 0; i < NUM_TIMERS; i++)
+        timers[i].callback = 0;
+    NVIC_ST_CTRL_R = 0;                                 // turn-off SysTick before reconfiguring
+    NVIC_ST_RELOAD_R = getSystemClock() / 1000 - 1;
+    NVIC_ST_CURRENT_R = 0;
+    NVIC_ST_CTRL_R = NVIC_ST_CTRL_CLK_SRC | NVIC_ST_CTRL_INTEN | NVIC_ST_CTRL_ENABLE;
+                                                        // system clock, interrupt on reload
+}
+
+// Reload SysTick for a 1 ms period after the system clock changed
+// The millisecond in progress is restarted, so every switch loses less than 1 ms
+void updateTimerClock()
+{
+    NVIC_ST_RELOAD_R = getSystemClock() / 1000 - 1;
+    NVIC_ST_CURRENT_R = 0;
+}
+
+// Returns the milliseconds since power up (wraps every 49 days)
+uint32_t getTimeMs()
+{
+    return timeMs;
+}
+
+// Add or replace the timer of a callback
+// Threads and interrupts both start timers, so the slot is found and filled with
+// interrupts masked; two callers can never claim the same free slot
+bool startTimer(_callback callback, uint32_t ms, uint32_t period)
+{
+    uint32_t mask;
+    uint8_t i, slot = NUM_TIMERS;
+    if (ms == 0)
+        return false;
+    mask = disableInterrupts();
+    for (i = 0; i < NUM_TIMERS; i++)
+    {
+        if (timers[i].callback == callback)
+        {
+            slot = i;
+            break;
+        }
+        if (timers[i].callback == 0 && slot == NUM_TIMERS)
+            slot = i;
+    }
+    if (slot < NUM_TIMERS)
+    {
+        timers[slot].period = period;
+        timers[slot].reload = ms;
+        timers[slot].remaining = ms;
+        timers[slot].callback = callback;
+    }
+    restoreInterrupts(mask);
+    return slot < NUM_TIMERS;
+}
+
+// Call back once after the given number of ms
+// Starting a callback that already has a timer restarts it
+bool startOneshotTimer(_callback callback, uint32_t ms)
+{
+    return startTimer(callback, ms, 0);
+}
+
+// Call back every given number of ms
+bool startPeriodicTimer(_callback callback, uint32_t ms)
+{
+    return startTimer(callback, ms, ms);
+}
+
+bool stopTimer(_callback callback)
+{
+    uint32_t mask = disableInterrupts();
+    bool found = false;
+    uint8_t i;
+    for (i = 0; i < NUM_TIMERS && !found; i++)
+    {
+        if (timers[i].callback == callback)
+        {
+            timers[i].callback = 0;
+            found = true;
+        }
+    }
+    restoreInterrupts(mask);
+    return found;
+}
+
+// Start the timer of a callback over with its original time
+bool restartTimer(_callback callback)
+{
+    uint32_t mask = disableInterrupts();
+    bool found = false;
+    uint8_t i;
+    for (i = 0; i < NUM_TIMERS && !found; i++)
+    {
+        if (timers[i].callback == callback)
+        {
+            timers[i].remaining = timers[i].reload;
+            found = true;
+        }
+    }
+    restoreInterrupts(mask);
+    return found;
+}
+
+// Advance the clock and run the callbacks that are due
+// Callbacks run in the interrupt and must be short
+void sysTickIsr()
+{
+    _callback callback;
+    uint8_t i;
+    timeMs++;
+    for (i = 0; i < NUM_TIMERS; i++)
+    {
+        callback = timers[i].callback;
+        if (callback == 0 || --timers[i].remaining != 0)
+            continue;
+        if (timers[i].period != 0)
+            timers[i].remaining = timers[i].period;
+        else
+            timers[i].callback = 0;
+        callback();
+    }
+}
@@ -0,0 +1,40 @@
+// Timer Service Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// SysTick:
+//   Interrupts every millisecond to advance the clock and the software timers
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#define NUM_TIMERS 10
+
+typedef void (*_callback)(void);
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initTimer(void);
+void updateTimerClock(void);
+uint32_t getTimeMs(void);
+bool startOneshotTimer(_callback callback, uint32_t ms);
+bool startPeriodicTimer(_callback callback, uint32_t ms);
+bool stopTimer(_callback callback);
+bool restartTimer(_callback callback);
+void sysTickIsr(void);
+
+#endif
@@ -0,0 +1,71 @@
+// Trace Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "uart0.h"
+#include "supervisor.h"
+#include "timer.h"
+#include "trace.h"
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+TRACE_ENTRY traceBuffer[MAX_TRACE];
+uint8_t traceIndex = 0;
+uint8_t traceCount = 0;
+
+char* traceStrings[TRACE_EVENTS] = {"step", "coast stop", "brake stop", "coast spread", "brake spread", "protect"};
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void clearTrace()
+{
+    traceIndex = 0;
+    traceCount = 0;
+}
+
+// Append an entry, overwriting the oldest one when the buffer is full
+void traceEvent(uint8_t step, uint8_t event, uint8_t code, int32_t value)
+{
+    TRACE_ENTRY *entry = &traceBuffer[traceIndex];
+    entry->time = getTimeMs();
+    entry->step = step;
+    entry->event = event;
+    entry->code = code;
+    entry->value = value;
+    traceIndex = (traceIndex + 1) % MAX_TRACE;
+    if (traceCount < MAX_TRACE)
+        traceCount++;
+}
+
+// Print the trace, oldest entry first
+void printTrace()
+{
+    char output[60];
+    uint8_t i;
+    TRACE_ENTRY *entry;
+    for (i = 0; i < traceCount; i++)
+    {
+        entry = &traceBuffer[(traceIndex + MAX_TRACE - traceCount + i) % MAX_TRACE];
+        sprintf(output, "%8u ms  %d. %s %s %d\n", entry->time, entry->step + 1,
+                traceStrings[entry->event], getErrorString(entry->code), entry->value);
+        putsUart0(output);
+    }
+}
@@ -0,0 +1,47 @@
+// Trace Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#define MAX_TRACE 32
+
+// Trace events
+#define TRACE_STEP          0   // an instruction finished; value is the run time in ms
+#define TRACE_COAST         1   // a coasting stop; value is the roll-out in mm
+#define TRACE_BRAKE         2   // a braking stop; value is the roll-out in mm
+#define TRACE_COAST_SPREAD  3   // end of run; value is max - min coasting roll-out in mm
+#define TRACE_BRAKE_SPREAD  4   // end of run; value is max - min braking roll-out in mm
+#define TRACE_PROTECT       5   // protective stop; value is the echo to motor off latency in us
+#define TRACE_EVENTS        6
+
+typedef struct _TRACE_ENTRY
+{
+    uint32_t time;          // supervisor time in ms
+    uint8_t step;           // instruction index
+    uint8_t event;          // TRACE_xxx
+    uint8_t code;           // ERR_xxx
+    int32_t value;          // event specific
+} TRACE_ENTRY;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void clearTrace(void);
+void traceEvent(uint8_t step, uint8_t event, uint8_t code, int32_t value);
+void printTrace(void);
+
+#endif
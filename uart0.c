@@ -21,6 +21,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "tm4c123gh6pm.h"
+#include "clock.h"
 #include "uart0.h"
 
 // PortA masks
@@ -31,6 +32,8 @@
 // Global variables
 //-----------------------------------------------------------------------------
 
+void (*uart0RxCallback)(void) = 0;   // called from the interrupt when characters arrive
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -38,9 +41,6 @@
 // Initialize UART0
 void initUart0()
 {
-    // Configure HW to work with 16 MHz XTAL, PLL enabled, system clock of 40 MHz
-    SYSCTL_RCC_R = SYSCTL_RCC_XTAL_16MHZ | SYSCTL_RCC_OSCSRC_MAIN | SYSCTL_RCC_USESYSDIV | (4 << SYSCTL_RCC_SYSDIV_S);
-
     // Set GPIO ports to use APB (not needed since default configuration -- for clarity)
     SYSCTL_GPIOHBCTL_R = 0;
 
@@ -61,9 +61,8 @@ void initUart0()
 
     // Configure UART0 to 115200 baud, 8N1 format
     UART0_CTL_R = 0;                                    // turn-off UART0 to allow safe programming
-    UART0_CC_R = UART_CC_CS_SYSCLK;                     // use system clock (40 MHz)
-    UART0_IBRD_R = 21;                                  // r = 40 MHz / (Nx115.2kHz), set floor(r)=21, where N=16
-    UART0_FBRD_R = 45;                                  // round(fract(r)*64)=45
+    UART0_CC_R = UART_CC_CS_SYSCLK;                     // use system clock (F_CPU)
+    setUart0BaudRate(UART0_BAUD_RATE, getSystemClock());// r = 80 MHz / (Nx115.2kHz) = 43.40, where N=16
     UART0_LCRH_R = UART_LCRH_WLEN_8 | UART_LCRH_FEN;    // configure for 8N1 w/ 16-level FIFO
     UART0_CTL_R = UART_CTL_TXE | UART_CTL_RXE | UART_CTL_UARTEN;
                                                         // enable TX, RX, and module
@@ -74,8 +73,18 @@ void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc)
 {
     uint32_t divisorTimes128 = (fcyc * 8) / baudRate;   // calculate divisor (r) in units of 1/128,
                                                         // where r = fcyc / 16 * baudRate
+    uint32_t ctl = UART0_CTL_R;
+    UART0_CTL_R = ctl & ~UART_CTL_UARTEN;                // the divisor must not change while enabled
     UART0_IBRD_R = divisorTimes128 >> 7;                 // set integer value to floor(r)
     UART0_FBRD_R = ((divisorTimes128 + 1)) >> 1 & 63;    // set fractional value to round(fract(r)*64)
+    UART0_LCRH_R = UART0_LCRH_R;                         // the divisor is latched by a write to LCRH
+    UART0_CTL_R = ctl;
+}
+
+// Blocking function that returns once the last character has left the transmitter
+void drainUart0()
+{
+    while (UART0_FR_R & UART_FR_BUSY);
 }
 
 // Blocking function that writes a serial character when the UART buffer is not full
@@ -94,9 +103,11 @@ void putsUart0(char* str)
 }
 
 // Blocking function that returns with serial data once the buffer is not empty
+// The core sleeps between checks; the RX interrupt or any other interrupt wakes it
 char getcUart0()
 {
-    while (UART0_FR_R & UART_FR_RXFE);               // wait if uart0 rx fifo empty
+    while (UART0_FR_R & UART_FR_RXFE)                // wait if uart0 rx fifo empty
+        __asm(" WFI");
     return UART0_DR_R & 0xFF;                        // get character from fifo
 }
 
@@ -105,3 +116,21 @@ bool kbhitUart0()
 {
     return !(UART0_FR_R & UART_FR_RXFE);
 }
+
+// Call a function from the interrupt whenever characters arrive
+// The receive interrupt fires at half a FIFO, the timeout 32 bit times after the last character
+void setUart0RxCallback(void (*callback)(void))
+{
+    uart0RxCallback = callback;
+    UART0_ICR_R = UART_ICR_RXIC | UART_ICR_RTIC;
+    UART0_IM_R |= UART_IM_RXIM | UART_IM_RTIM;
+    NVIC_EN0_R |= 1 << (INT_UART0-16);
+}
+
+// Characters arrived; they are left in the FIFO for the callback's owner to read
+void uart0Isr()
+{
+    UART0_ICR_R = UART_ICR_RXIC | UART_ICR_RTIC;
+    if (uart0RxCallback)
+        uart0RxCallback();
+}
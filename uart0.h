@@ -21,15 +21,20 @@
 #ifndef UART0_H_
 #define UART0_H_
 
+#define UART0_BAUD_RATE 115200
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
 void initUart0();
 void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc);
+void drainUart0();
 void putcUart0(char c);
 void putsUart0(char* str);
 char getcUart0();
 bool kbhitUart0();
+void setUart0RxCallback(void (*callback)(void));
+void uart0Isr();
 
 #endif
@@ -0,0 +1,620 @@
+// Ultrasonic Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Ultrasonic sensors (trigger, echo):
+//   Front PE1, PE3
+//   Left  PD2, PD3
+//   Right PA6, PA7
+//   Rear  PA2, PA3
+//   PD0 and PD1 are avoided, they are tied to PB6 and PB7 on the LaunchPad
+// Timers:
+//   TIMER1 free-runs at the system clock to timestamp echo edges
+//   TIMER4A one-shot ends the trigger pulse and times out missing echoes
+//   TIMER3A one-shot starts the next group of sensors
+// Temperature:
+//   Internal sensor sampled about once a second to correct the speed of sound
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "clock.h"
+#include "supervisor.h"
+#include "timer.h"
+#include "temperature.h"
+#include "motion.h"
+#include "ultrasonic.h"
+
+// GPIO ports with sensors
+#define PORT_A 0
+#define PORT_D 1
+#define PORT_E 2
+#define PORTS  3
+
+#define RANGE_GROUPS 3
+
+#define COUNTS_PER_US (getSystemClock() / 1000000)
+
+// Measurement states
+#define STATE_IDLE      0
+#define STATE_WAIT_ECHO 1       // triggered, waiting for the echo to go high
+#define STATE_ECHO      2       // echo is high
+
+typedef struct _RANGE_SENSOR
+{
+    uint8_t port;           // PORT_x
+    uint8_t triggerMask;
+    uint8_t echoMask;
+    uint8_t group;          // sensors of a group are triggered together
+    bool protect;           // checked against the protective-stop zone on forward moves
+} RANGE_SENSOR;
+
+typedef struct _RANGING
+{
+    uint8_t state;
+    uint32_t echoStart;     // TIMER1 time of the echo rising edge
+    uint32_t sequence;      // incremented each time a result is published
+    uint8_t status;         // RANGE_OK, RANGE_NO_ECHO, RANGE_NO_OBJECT
+    uint32_t width;         // echo width of the last result, system clocks
+    uint32_t lastSample;    // TIMER1 time of the last result
+} RANGING;
+
+typedef struct _SCHEDULER
+{
+    uint8_t group;          // group in flight
+    bool triggering;        // trigger pins of the group are high
+    uint8_t pending;        // one bit per sensor still waiting for its result
+    uint32_t slotStart;     // TIMER1 time the group was triggered
+    uint8_t triggers[PORTS];
+} SCHEDULER;
+
+typedef struct _PROTECT
+{
+    uint32_t zone;          // mm, 0 disables
+    bool tripped;           // a stop happened that the executor has not seen
+    uint32_t distance;      // reading that caused the last stop, mm
+    uint32_t latency;       // echo falling edge to PWM commit of the last stop, us
+    uint32_t maxLatency;
+} PROTECT;
+
+typedef struct _RANGE_FILTER
+{
+    uint32_t window[RANGE_WINDOW];  // most recent distances
+    uint8_t index;
+    uint8_t count;          // valid entries in window[]
+    uint8_t misses;         // consecutive measurements without an echo
+    uint8_t clamped;        // consecutive samples held back by the rate limit
+    uint32_t distance;      // filtered distance
+    bool valid;
+} RANGE_FILTER;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+// Sensor configuration table
+// Front and rear face away from each other, so they share a slot
+const RANGE_SENSOR rangeSensors[RANGE_SENSORS] =
+{
+    {PORT_E, 2, 8, 0, true},        // front: PE1, PE3
+    {PORT_D, 4, 8, 1, false},       // left: PD2, PD3
+    {PORT_A, 64, 128, 2, false},    // right: PA6, PA7
+    {PORT_A, 4, 8, 0, false},       // rear: PA2, PA3
+};
+
+volatile RANGING ranging[RANGE_SENSORS];
+volatile RANGE_FILTER rangeFilters[RANGE_SENSORS];
+volatile SCHEDULER rangeScheduler;
+volatile PROTECT protect = {RANGE_DEFAULT_PROTECT_MM};
+uint32_t rangeRate = RANGE_DEFAULT_RATE_HZ;
+uint32_t rangeSlotUs = 1000000 / RANGE_DEFAULT_RATE_HZ;
+uint32_t rangeScale;                // mm per echo clock, unsigned Q32
+uint32_t soundSpeed;
+uint32_t tempDeadline;              // time of the next temperature update
+void (*rangeCallback)(void) = 0;    // called from the interrupt of every new result
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Precompute the echo scale for a speed of sound
+// The echo covers the range twice: mm = width / F * speed / 2
+void setSoundSpeed(uint32_t mmPerSecond)
+{
+    soundSpeed = mmPerSecond;
+    rangeScale = ((uint64_t)mmPerSecond << 31) / getSystemClock();
+}
+
+// Rescale the echo widths after the system clock changed
+// A measurement in progress across the change reads once with the wrong scale
+void updateUltrasonicClock()
+{
+    setSoundSpeed(soundSpeed);
+}
+
+uint32_t getSoundSpeed()
+{
+    return soundSpeed;
+}
+
+// Configure the trigger outputs and the echo inputs of every sensor on a port,
+// with an interrupt on both edges of each echo
+void initRangePort(uint8_t port)
+{
+    uint8_t trigger = 0, echo = 0, i;
+    for (i = 0; i < RANGE_SENSORS; i++)
+    {
+        if (rangeSensors[i].port == port)
+        {
+            trigger |= rangeSensors[i].triggerMask;
+            echo |= rangeSensors[i].echoMask;
+        }
+    }
+    if (trigger == 0)
+        return;
+
+    switch (port)
+    {
+    case PORT_A:
+        GPIO_PORTA_DIR_R |= trigger;
+        GPIO_PORTA_DIR_R &= ~echo;
+        GPIO_PORTA_DR2R_R |= trigger | echo;
+        GPIO_PORTA_DEN_R |= trigger | echo;
+        GPIO_PORTA_DATA_BITS_R[trigger] = 0;
+        GPIO_PORTA_IM_R &= ~echo;                       // mask the interrupt while configuring
+        GPIO_PORTA_IS_R &= ~echo;                       // edge sensitive
+        GPIO_PORTA_IBE_R |= echo;                       // both edges
+        GPIO_PORTA_ICR_R = echo;
+        GPIO_PORTA_IM_R |= echo;
+        NVIC_EN0_R |= 1 << (INT_GPIOA-16);
+        break;
+    case PORT_D:
+        GPIO_PORTD_DIR_R |= trigger;
+        GPIO_PORTD_DIR_R &= ~echo;
+        GPIO_PORTD_DR2R_R |= trigger | echo;
+        GPIO_PORTD_DEN_R |= trigger | echo;
+        GPIO_PORTD_DATA_BITS_R[trigger] = 0;
+        GPIO_PORTD_IM_R &= ~echo;
+        GPIO_PORTD_IS_R &= ~echo;
+        GPIO_PORTD_IBE_R |= echo;
+        GPIO_PORTD_ICR_R = echo;
+        GPIO_PORTD_IM_R |= echo;
+        NVIC_EN0_R |= 1 << (INT_GPIOD-16);
+        break;
+    case PORT_E:
+        GPIO_PORTE_DIR_R |= trigger;
+        GPIO_PORTE_DIR_R &= ~echo;
+        GPIO_PORTE_DR2R_R |= trigger | echo;
+        GPIO_PORTE_DEN_R |= trigger | echo;
+        GPIO_PORTE_DATA_BITS_R[trigger] = 0;
+        GPIO_PORTE_IM_R &= ~echo;
+        GPIO_PORTE_IS_R &= ~echo;
+        GPIO_PORTE_IBE_R |= echo;
+        GPIO_PORTE_ICR_R = echo;
+        GPIO_PORTE_IM_R |= echo;
+        NVIC_EN0_R |= 1 << (INT_GPIOE-16);
+        break;
+    }
+}
+
+// Drive the given trigger pins of a port without touching the other pins
+void setTriggers(uint8_t port, uint8_t mask, uint8_t value)
+{
+    switch (port)
+    {
+    case PORT_A:
+        GPIO_PORTA_DATA_BITS_R[mask] = value;
+        break;
+    case PORT_D:
+        GPIO_PORTD_DATA_BITS_R[mask] = value;
+        break;
+    case PORT_E:
+        GPIO_PORTE_DATA_BITS_R[mask] = value;
+        break;
+    }
+}
+
+// Run TIMER4A once for the given number of microseconds
+void armRangeTimer(uint32_t us)
+{
+    TIMER4_CTL_R &= ~TIMER_CTL_TAEN;
+    TIMER4_ICR_R = TIMER_ICR_TATOCINT;
+    TIMER4_TAILR_R = us * COUNTS_PER_US;
+    TIMER4_CTL_R |= TIMER_CTL_TAEN;
+}
+
+// Run TIMER3A once for the given number of microseconds
+void armSlotTimer(uint32_t us)
+{
+    TIMER3_CTL_R &= ~TIMER_CTL_TAEN;
+    TIMER3_ICR_R = TIMER_ICR_TATOCINT;
+    TIMER3_TAILR_R = us * COUNTS_PER_US;
+    TIMER3_CTL_R |= TIMER_CTL_TAEN;
+}
+
+// Initialize the sensor pins, the timestamp timer and the scheduler timers
+void initUltrasonic()
+{
+    uint8_t i;
+
+    // Enable clocks
+    SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R1 | SYSCTL_RCGCTIMER_R3 | SYSCTL_RCGCTIMER_R4;
+    SYSCTL_RCGCGPIO_R |= SYSCTL_RCGCGPIO_R0 | SYSCTL_RCGCGPIO_R3 | SYSCTL_RCGCGPIO_R4;
+    _delay_cycles(3);
+
+    for (i = 0; i < PORTS; i++)
+        initRangePort(i);
+
+    // Free-running timestamp counter
+    TIMER1_CTL_R &= ~TIMER_CTL_TAEN;                    // turn-off timer before reconfiguring
+    TIMER1_CFG_R = TIMER_CFG_32_BIT_TIMER;              // configure as 32-bit timer (A+B)
+    TIMER1_TAMR_R = TIMER_TAMR_TAMR_PERIOD | TIMER_TAMR_TACDIR;
+                                                        // configure for periodic mode (count up)
+    TIMER1_TAILR_R = 0xFFFFFFFF;
+    TIMER1_IMR_R = 0;                                   // turn-off interrupts
+    TIMER1_CTL_R |= TIMER_CTL_TAEN;
+
+    // Trigger and timeout timer, started for each group
+    TIMER4_CTL_R &= ~TIMER_CTL_TAEN;
+    TIMER4_CFG_R = TIMER_CFG_32_BIT_TIMER;
+    TIMER4_TAMR_R = TIMER_TAMR_TAMR_1_SHOT;             // configure for one-shot mode (count down)
+    TIMER4_IMR_R = TIMER_IMR_TATOIM;
+    NVIC_EN2_R |= 1 << (INT_TIMER4A-16-64);
+
+    setSoundSpeed(RANGE_SOUND_SPEED_MM_S);
+    tempDeadline = getTimeMs();
+
+    // Slot timer, restarted after each group
+    TIMER3_CTL_R &= ~TIMER_CTL_TAEN;
+    TIMER3_CFG_R = TIMER_CFG_32_BIT_TIMER;
+    TIMER3_TAMR_R = TIMER_TAMR_TAMR_1_SHOT;
+    TIMER3_IMR_R = TIMER_IMR_TATOIM;
+    NVIC_EN1_R |= 1 << (INT_TIMER3A-16-32);
+    armSlotTimer(RANGE_GUARD_US);
+}
+
+// Returns the median of a filter window
+uint32_t rangeMedian(volatile RANGE_FILTER *filter)
+{
+    uint32_t sorted[RANGE_WINDOW], value;
+    uint8_t i, j;
+    for (i = 0; i < filter->count; i++)
+    {
+        value = filter->window[i];
+        for (j = i; j > 0 && sorted[j - 1] > value; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = value;
+    }
+    return sorted[filter->count / 2];
+}
+
+// Add a result to the filter of a sensor
+// The output follows the median of the last readings, but moves by at most the
+// rate limit over the time since the last sample unless the new level holds for
+// RANGE_MAX_CLAMPED samples
+void filterRange(uint8_t sensor, uint8_t status, uint32_t width, uint32_t dtUs)
+{
+    volatile RANGE_FILTER *filter = &rangeFilters[sensor];
+    uint32_t median, step;
+    if (status == RANGE_NO_ECHO)
+    {
+        if (filter->misses < 255)
+            filter->misses++;
+        if (filter->misses >= ECHO_MAX_MISSES)
+        {
+            filter->count = 0;
+            filter->index = 0;
+            filter->valid = false;
+        }
+        return;
+    }
+    filter->misses = 0;
+    filter->window[filter->index] = echoToMm(width);
+    filter->index = (filter->index + 1) % RANGE_WINDOW;
+    if (filter->count < RANGE_WINDOW)
+        filter->count++;
+    median = rangeMedian(filter);
+
+    if (dtUs > 1000000)
+        dtUs = 1000000;
+    step = dtUs * RANGE_MAX_RATE_MM_S / 1000000;
+    if (step == 0)
+        step = 1;
+    if (!filter->valid || filter->clamped >= RANGE_MAX_CLAMPED)
+    {
+        filter->distance = median;
+        filter->clamped = 0;
+    }
+    else if (median > filter->distance + step)
+    {
+        filter->distance += step;
+        filter->clamped++;
+    }
+    else if (median + step < filter->distance)
+    {
+        filter->distance -= step;
+        filter->clamped++;
+    }
+    else
+    {
+        filter->distance = median;
+        filter->clamped = 0;
+    }
+    filter->valid = filter->count >= RANGE_MIN_VALID;
+}
+
+// The group has no results left to wait for
+// The next group starts after the guard time, or at the end of the slot if that is later
+void groupDone()
+{
+    uint32_t elapsed, wait;
+    TIMER4_CTL_R &= ~TIMER_CTL_TAEN;
+    elapsed = (TIMER1_TAV_R - rangeScheduler.slotStart) / COUNTS_PER_US;
+    wait = rangeSlotUs > elapsed ? rangeSlotUs - elapsed : 0;
+    if (wait < RANGE_GUARD_US)
+        wait = RANGE_GUARD_US;
+    rangeScheduler.group = (rangeScheduler.group + 1) % RANGE_GROUPS;
+    armSlotTimer(wait);
+}
+
+void publishRange(uint8_t sensor, uint8_t status, uint32_t width, uint32_t now)
+{
+    volatile RANGING *r = &ranging[sensor];
+    r->state = STATE_IDLE;
+    r->status = status;
+    r->width = width;
+    filterRange(sensor, status, width, (now - r->lastSample) / COUNTS_PER_US);
+    r->lastSample = now;
+    r->sequence++;
+    if (rangeCallback)
+        rangeCallback();
+    rangeScheduler.pending &= ~(1 << sensor);
+    if (rangeScheduler.pending == 0)
+        groupDone();
+}
+
+// Trigger every sensor of the current group
+void startGroup()
+{
+    uint8_t i;
+    for (i = 0; i < PORTS; i++)
+        rangeScheduler.triggers[i] = 0;
+    rangeScheduler.pending = 0;
+    for (i = 0; i < RANGE_SENSORS; i++)
+    {
+        if (rangeSensors[i].group != rangeScheduler.group)
+            continue;
+        ranging[i].state = STATE_WAIT_ECHO;
+        rangeScheduler.pending |= 1 << i;
+        rangeScheduler.triggers[rangeSensors[i].port] |= rangeSensors[i].triggerMask;
+    }
+    rangeScheduler.slotStart = TIMER1_TAV_R;
+    for (i = 0; i < PORTS; i++)
+        setTriggers(i, rangeScheduler.triggers[i], 0xFF);
+    rangeScheduler.triggering = true;
+    armRangeTimer(RANGE_TRIGGER_US);
+}
+
+// Set the slot rate of the scheduler
+// Returns false if the rate is out of range
+bool setRangingRate(uint32_t hz)
+{
+    if (hz < RANGE_MIN_RATE_HZ || hz > RANGE_MAX_RATE_HZ)
+        return false;
+    rangeRate = hz;
+    rangeSlotUs = 1000000 / hz;
+    return true;
+}
+
+uint32_t getRangingRate()
+{
+    return rangeRate;
+}
+
+// Returns a count that changes each time a sensor publishes a result
+uint32_t getRangeSequence(uint8_t sensor)
+{
+    return ranging[sensor].sequence;
+}
+
+uint8_t getRangeStatus(uint8_t sensor)
+{
+    return ranging[sensor].status;
+}
+
+// Converts an echo width in system clocks to mm
+// One 32x32 multiply with a 64-bit result; the high word is the distance
+uint32_t echoToMm(uint32_t width)
+{
+    return ((uint64_t)width * rangeScale) >> 32;
+}
+
+// Returns the filtered distance of a sensor in mm without waiting
+uint32_t getRangeDistance(uint8_t sensor)
+{
+    return rangeFilters[sensor].distance;
+}
+
+// Returns true once the filter of a sensor holds enough recent readings
+bool isRangeValid(uint8_t sensor)
+{
+    return rangeFilters[sensor].valid;
+}
+
+// Returns the number of consecutive measurements of a sensor without an echo
+uint8_t getRangeMisses(uint8_t sensor)
+{
+    return rangeFilters[sensor].misses;
+}
+
+// Copies the filtered distances of all sensors
+// Returns a mask with a bit set for each sensor whose distance is valid
+uint8_t getRangeDistances(uint32_t distances[RANGE_SENSORS])
+{
+    uint8_t i, valid = 0;
+    for (i = 0; i < RANGE_SENSORS; i++)
+    {
+        distances[i] = rangeFilters[i].distance;
+        if (rangeFilters[i].valid)
+            valid |= 1 << i;
+    }
+    return valid;
+}
+
+void setProtectZone(uint32_t mm)
+{
+    protect.zone = mm;
+}
+
+uint32_t getProtectZone()
+{
+    return protect.zone;
+}
+
+// Returns true once after each protective stop, with its reading and latency
+bool takeProtectStop(uint32_t *distance, uint32_t *latencyUs)
+{
+    if (!protect.tripped)
+        return false;
+    *distance = protect.distance;
+    *latencyUs = protect.latency;
+    protect.tripped = false;
+    return true;
+}
+
+// Returns the longest echo to motor off latency seen, in us
+uint32_t getProtectMaxLatency()
+{
+    return protect.maxLatency;
+}
+
+// Call a function from the interrupt that publishes each result, 0 for none
+// The function must be short; it is meant to wake the code that consumes readings
+void setRangeCallback(void (*callback)(void))
+{
+    rangeCallback = callback;
+}
+
+// Cut the motors if a forward move reads an object inside the zone
+// The raw reading is used, not the filtered one, so the stop happens in the ISR of
+// the echo that crossed the zone. The latency runs from the echo edge to the PWM
+// commit; the outputs follow at the end of the current PWM period.
+void checkProtectZone(uint32_t echoTime, uint32_t width)
+{
+    uint32_t dist;
+    if (protect.zone == 0 || !isMovingForward())
+        return;
+    dist = echoToMm(width);
+    if (dist >= protect.zone)
+        return;
+    haltMotors();
+    protect.latency = (TIMER1_TAV_R - echoTime) / COUNTS_PER_US;
+    protect.distance = dist;
+    if (protect.latency > protect.maxLatency)
+        protect.maxLatency = protect.latency;
+    protect.tripped = true;
+}
+
+// Ends the trigger pulse of the group, then times out missing or endless echoes
+void rangeTimerIsr()
+{
+    uint32_t now = TIMER1_TAV_R;
+    uint8_t i;
+    TIMER4_ICR_R = TIMER_ICR_TATOCINT;
+    if (rangeScheduler.triggering)
+    {
+        for (i = 0; i < PORTS; i++)
+            setTriggers(i, rangeScheduler.triggers[i], 0);
+        rangeScheduler.triggering = false;
+        armRangeTimer(ECHO_START_TIMEOUT_US + ECHO_WIDTH_TIMEOUT_US);
+        return;
+    }
+    for (i = 0; i < RANGE_SENSORS; i++)
+    {
+        if (!(rangeScheduler.pending & (1 << i)))
+            continue;
+        if (ranging[i].state == STATE_ECHO)
+            publishRange(i, RANGE_NO_OBJECT, ECHO_WIDTH_TIMEOUT_US * COUNTS_PER_US, now);
+        else
+            publishRange(i, RANGE_NO_ECHO, 0, now);
+    }
+}
+
+// Starts the next group of sensors
+// Every RANGE_TEMP_INTERVAL_MS the scale is updated from the last temperature,
+// c = 331.3 + 0.606 T m/s, and the next temperature conversion is started
+void rangeSampleIsr()
+{
+    TIMER3_ICR_R = TIMER_ICR_TATOCINT;
+    if (deadlinePassed(tempDeadline))
+    {
+        if (isTemperatureValid())
+            setSoundSpeed(331300 + 606 * getTemperature() / 10);
+        startTemperatureSample();
+        tempDeadline = makeDeadline(RANGE_TEMP_INTERVAL_MS);
+    }
+    startGroup();
+}
+
+// Timestamps both edges of the echo pulses of the sensors on a port
+void echoEdge(uint8_t port, uint8_t edges, uint8_t level, uint32_t now)
+{
+    uint8_t i;
+    volatile RANGING *r;
+    for (i = 0; i < RANGE_SENSORS; i++)
+    {
+        if (rangeSensors[i].port != port || !(edges & rangeSensors[i].echoMask))
+            continue;
+        r = &ranging[i];
+        if (level & rangeSensors[i].echoMask)
+        {
+            if (r->state == STATE_WAIT_ECHO)
+            {
+                r->echoStart = now;
+                r->state = STATE_ECHO;
+            }
+        }
+        else if (r->state == STATE_ECHO)
+        {
+            if (rangeSensors[i].protect)
+                checkProtectZone(now, now - r->echoStart);
+            publishRange(i, RANGE_OK, now - r->echoStart, now);
+        }
+    }
+}
+
+void echoPortAIsr()
+{
+    uint32_t now = TIMER1_TAV_R;
+    uint8_t edges = GPIO_PORTA_MIS_R;
+    GPIO_PORTA_ICR_R = edges;
+    echoEdge(PORT_A, edges, GPIO_PORTA_DATA_R, now);
+}
+
+void echoPortDIsr()
+{
+    uint32_t now = TIMER1_TAV_R;
+    uint8_t edges = GPIO_PORTD_MIS_R;
+    GPIO_PORTD_ICR_R = edges;
+    echoEdge(PORT_D, edges, GPIO_PORTD_DATA_R, now);
+}
+
+void echoPortEIsr()
+{
+    uint32_t now = TIMER1_TAV_R;
+    uint8_t edges = GPIO_PORTE_MIS_R;
+    GPIO_PORTE_ICR_R = edges;
+    echoEdge(PORT_E, edges, GPIO_PORTE_DATA_R, now);
+}
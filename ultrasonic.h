@@ -0,0 +1,94 @@
+// Ultrasonic Library
+// Nicholas Untrecht
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    80 MHz
+
+// Hardware configuration:
+// Ultrasonic sensors (trigger, echo):
+//   Front PE1, PE3
+//   Left  PD2, PD3
+//   Right PA6, PA7
+//   Rear  PA2, PA3
+// Timers:
+//   TIMER1 free-runs at the system clock to timestamp echo edges
+//   TIMER4A one-shot ends the trigger pulse and times out missing echoes
+//   TIMER3A one-shot starts the next group of sensors
+// Temperature:
+//   Internal sensor sampled about once a second to correct the speed of sound
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef ULTRASONIC_H_
+#define ULTRASONIC_H_
+
+// Sensors, in the order of the configuration table
+#define RANGE_FRONT   0
+#define RANGE_LEFT    1
+#define RANGE_RIGHT   2
+#define RANGE_REAR    3
+#define RANGE_SENSORS 4
+
+#define RANGE_TRIGGER_US 12     // the sensor needs a trigger of at least 10 us
+
+#define RANGE_SOUND_SPEED_MM_S 343000   // speed of sound in air at 20 C, until the temperature is known
+#define RANGE_TEMP_INTERVAL_MS 1000     // temperature sample and scale update period
+
+#define RANGE_DEFAULT_PROTECT_MM 150    // protective-stop zone for forward moves, 0 disables
+
+// Result of the last measurement
+#define RANGE_OK        0
+#define RANGE_NO_ECHO   1       // the echo never went high
+#define RANGE_NO_OBJECT 2       // the echo stayed high past the width timeout
+
+// Scheduler
+// Groups of sensors are triggered one after the other. A group starts once the
+// previous one has finished and its echoes have died out for the guard time, but
+// not more often than the slot rate.
+#define RANGE_DEFAULT_RATE_HZ 60    // slots per second, shared by all groups
+#define RANGE_MIN_RATE_HZ     5
+#define RANGE_MAX_RATE_HZ     100
+#define RANGE_GUARD_US        5000  // quiet time between groups against crosstalk
+
+// Filter
+#define RANGE_WINDOW          5     // readings in the median filter
+#define RANGE_MIN_VALID       3     // readings needed before the distance is valid
+#define RANGE_MAX_RATE_MM_S   1000  // faster changes are limited, the robot is much slower
+#define RANGE_MAX_CLAMPED     3     // a step that persists this many samples is accepted
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initUltrasonic(void);
+void setSoundSpeed(uint32_t mmPerSecond);
+void updateUltrasonicClock(void);
+uint32_t getSoundSpeed(void);
+uint32_t echoToMm(uint32_t width);
+bool setRangingRate(uint32_t hz);
+uint32_t getRangingRate(void);
+uint32_t getRangeSequence(uint8_t sensor);
+uint8_t getRangeStatus(uint8_t sensor);
+uint32_t getRangeDistance(uint8_t sensor);
+bool isRangeValid(uint8_t sensor);
+uint8_t getRangeMisses(uint8_t sensor);
+uint8_t getRangeDistances(uint32_t distances[RANGE_SENSORS]);
+void setProtectZone(uint32_t mm);
+uint32_t getProtectZone(void);
+bool takeProtectStop(uint32_t *distance, uint32_t *latencyUs);
+uint32_t getProtectMaxLatency(void);
+void setRangeCallback(void (*callback)(void));
+void rangeTimerIsr(void);
+void rangeSampleIsr(void);
+void echoPortAIsr(void);
+void echoPortDIsr(void);
+void echoPortEIsr(void);
+
+#endif
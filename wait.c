@@ -6,7 +6,11 @@
 //-----------------------------------------------------------------------------
 
 // Target uC:       TM4C123GH6PM
-// System Clock:    40 MHz
+// System Clock:    getSystemClock()
+
+// Hardware configuration:
+// DWT:
+//   The cycle counter times every wait; initCycleCounter() must have been called
 
 //-----------------------------------------------------------------------------
 // Device includes, defines, and assembler directives
@@ -14,25 +18,39 @@
 
 #include <stdint.h>
 #include "tm4c123gh6pm.h"
+#include "clock.h"
 #include "wait.h"
 
+#define CYCLES_PER_US (getSystemClock() / 1000000)
+#define WAIT_CHUNK_US 1000000       // keeps the cycle count of one wait from overflowing
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-// Approximate busy waiting (in units of microseconds), given a 40 MHz system clock
+// Busy wait for a number of system clock cycles
+// The count is compared as a difference, so the wrap of the counter is harmless
+void waitCycles(uint32_t cycles)
+{
+    uint32_t start = DWT_CYCCNT_R;
+    while (DWT_CYCCNT_R - start < cycles);
+}
+
+// Busy waiting in units of microseconds, exact to a few cycles at any system clock
 void waitMicrosecond(uint32_t us)
 {
-	__asm("WMS_LOOP0:   MOV  R1, #6");          // 1
-    __asm("WMS_LOOP1:   SUB  R1, #1");          // 6
-    __asm("             CBZ  R1, WMS_DONE1");   // 5+1*3
-    __asm("             NOP");                  // 5
-    __asm("             NOP");                  // 5
-    __asm("             B    WMS_LOOP1");       // 5*2 (speculative, so P=1)
-    __asm("WMS_DONE1:   SUB  R0, #1");          // 1
-    __asm("             CBZ  R0, WMS_DONE0");   // 1
-	__asm("             NOP");                  // 1
-    __asm("             B    WMS_LOOP0");       // 1*2 (speculative, so P=1)
-    __asm("WMS_DONE0:");                        // ---
-                                                // 40 clocks/us + error
+    while (us > WAIT_CHUNK_US)
+    {
+        waitCycles(WAIT_CHUNK_US * CYCLES_PER_US);
+        us -= WAIT_CHUNK_US;
+    }
+    waitCycles(us * CYCLES_PER_US);
+}
+
+// Busy waiting in units of nanoseconds, rounded up to whole cycles
+// Meant for short pulses, the call itself adds a few cycles; the product is taken in
+// 64 bits, so the whole 32-bit range (4.29 s) is exact at any system clock
+void waitNanosecond(uint32_t ns)
+{
+    waitCycles(((uint64_t)ns * CYCLES_PER_US + 999) / 1000);
 }
@@ -6,7 +6,7 @@
 //-----------------------------------------------------------------------------
 
 // Target uC:       TM4C123GH6PM
-// System Clock:    40 MHz
+// System Clock:    getSystemClock()
 
 #ifndef WAIT_H_
 #define WAIT_H_
@@ -15,6 +15,8 @@
 // Subroutines
 //-----------------------------------------------------------------------------
 
+void waitCycles(uint32_t cycles);
 void waitMicrosecond(uint32_t us);
+void waitNanosecond(uint32_t ns);
 
 #endif